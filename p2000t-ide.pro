@@ -11,42 +11,69 @@ CONFIG += c++11
 SOURCES += \
     src/dialogslotselection.cpp \
     src/assemblyhighlighter.cpp \
+    src/chipdescriptor.cpp \
     src/codeeditor.cpp \
     src/fileallocationtablep2000t.cpp \
+    src/dumpthread.cpp \
+    src/flashjournal.cpp \
+    src/flashplanner.cpp \
+    src/flashscheduler.cpp \
     src/flashthread.cpp \
+    src/image_manifest.cpp \
     src/ioworker.cpp \
     src/main.cpp \
     src/mainwindow.cpp \
+    src/progressmonitor.cpp \
     src/qhexview.cpp \
     src/readthread.cpp \
     src/romwidget.cpp \
     src/searchwidget.cpp \
+    src/serial_capture.cpp \
+    src/serial_command_engine.cpp \
     src/serial_interface.cpp \
+    src/serial_ring_buffer.cpp \
     src/serialwidget.cpp \
+    src/slotcache.cpp \
     src/threadcompile.cpp \
     src/threadrun.cpp \
     src/threadtl866.cpp \
-    src/tl866widget.cpp
+    src/tl866_output_parser.cpp \
+    src/tl866widget.cpp \
+    src/trace.cpp
 
 HEADERS += \
     src/dialogslotselection.h \
     src/assemblyhighlighter.h \
+    src/cancellationtoken.h \
+    src/chipdescriptor.h \
     src/codeeditor.h \
     src/config.h \
     src/fileallocationtablep2000t.h \
+    src/dumpthread.h \
+    src/flashjournal.h \
+    src/flashplanner.h \
+    src/flashscheduler.h \
     src/flashthread.h \
+    src/image_manifest.h \
     src/ioworker.h \
     src/mainwindow.h \
+    src/progressmonitor.h \
     src/qhexview.h \
     src/readthread.h \
     src/romwidget.h \
     src/searchwidget.h \
+    src/serial_capture.h \
+    src/serial_command_engine.h \
     src/serial_interface.h \
+    src/serial_ring_buffer.h \
     src/serialwidget.h \
+    src/slotcache.h \
     src/threadcompile.h \
     src/threadrun.h \
     src/threadtl866.h \
-    src/tl866widget.h
+    src/tl866_output_parser.h \
+    src/tl866widget.h \
+    src/trace.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,93 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <atomic>
+#include <string>
+
+/**
+ * @brief Cooperative cancellation of an operation on the cartridge reader
+ *
+ * The token is shared between the thread requesting the cancellation (e.g.
+ * the GUI) and the worker performing the operation. The worker checks the
+ * token between commands; commands that are already in flight are always
+ * completed such that the chip is left in a well-defined state.
+ *
+ * An operation is also cancelled once its deadline has expired.
+ */
+class CancellationToken {
+
+private:
+    std::atomic<bool> cancelled{false};     // explicitly cancelled
+    QDeadlineTimer deadline;                // deadline of the operation
+    mutable QMutex mutex;                   // protects the deadline
+
+public:
+    /**
+     * @brief Constructor, the token has no deadline
+     */
+    CancellationToken() : deadline(QDeadlineTimer::Forever) {}
+
+    /**
+     * @brief Request cancellation of the operation
+     */
+    inline void cancel() {
+        this->cancelled = true;
+    }
+
+    /**
+     * @brief Set the deadline of the operation
+     * @param msecs time from now in ms, negative for no deadline
+     */
+    inline void set_deadline(qint64 msecs) {
+        QMutexLocker lock(&this->mutex);
+        this->deadline = msecs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(msecs);
+    }
+
+    /**
+     * @brief Whether the deadline of the operation has expired
+     */
+    inline bool is_expired() const {
+        QMutexLocker lock(&this->mutex);
+        return this->deadline.hasExpired();
+    }
+
+    /**
+     * @brief Whether the operation should stop
+     */
+    inline bool is_cancelled() const {
+        return this->cancelled || this->is_expired();
+    }
+
+    /**
+     * @brief Get a description of why the operation was stopped
+     */
+    inline std::string get_reason() const {
+        return this->cancelled ? "Operation cancelled by user" : "Operation deadline exceeded";
+    }
+};
+
+#endif // CANCELLATIONTOKEN_H
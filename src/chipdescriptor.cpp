@@ -0,0 +1,51 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "chipdescriptor.h"
+
+/**
+ * @brief Get all supported chips
+ *
+ * Timings are the maximum values of the SST39SF0x0A datasheet.
+ */
+const std::vector<ChipDescriptor>& ChipDescriptor::get_chips() {
+    static const std::vector<ChipDescriptor> chips = {
+        {0xBFB5, "SST39SF010", 0x20000, 0x1000, 25, 100},
+        {0xBFB6, "SST39SF020", 0x40000, 0x1000, 25, 100},
+        {0xBFB7, "SST39SF040", 0x80000, 0x1000, 25, 100},
+    };
+
+    return chips;
+}
+
+/**
+ * @brief Look up a chip by its id
+ * @param chip_id chip id
+ * @return descriptor or nullptr when the chip is not supported
+ */
+const ChipDescriptor* ChipDescriptor::find(uint16_t chip_id) {
+    for(const auto& chip : get_chips()) {
+        if(chip.chip_id == chip_id) {
+            return &chip;
+        }
+    }
+
+    return nullptr;
+}
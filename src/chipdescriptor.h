@@ -0,0 +1,102 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef CHIPDESCRIPTOR_H
+#define CHIPDESCRIPTOR_H
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Geometry and timing of a flash chip supported by the cartridge reader
+ *
+ * The cartridge reader transfers data in blocks of 0x100 bytes and the
+ * cartridge is divided into slots of 0x4000 bytes, independent of the chip.
+ * The capacity, sector size and erase timing depend on the chip and are
+ * looked up by the chip id as reported by DEVIDSST.
+ */
+struct ChipDescriptor {
+    static const unsigned int BLOCK_SIZE = 0x100;       // transfer unit of the cartridge reader
+    static const unsigned int SLOT_SIZE = 0x4000;       // size of a ROM slot on the cartridge
+
+    uint16_t chip_id;               // manufacturer and device id
+    const char* name;               // part number
+    unsigned int capacity;          // size in bytes
+    unsigned int sector_size;       // size of the smallest erasable unit in bytes
+    unsigned int sector_erase_time; // maximum duration of a sector erase in ms
+    unsigned int chip_erase_time;   // maximum duration of a chip erase in ms
+
+    /**
+     * @brief Look up a chip by its id
+     * @param chip_id chip id
+     * @return descriptor or nullptr when the chip is not supported
+     */
+    static const ChipDescriptor* find(uint16_t chip_id);
+
+    /**
+     * @brief Get all supported chips
+     */
+    static const std::vector<ChipDescriptor>& get_chips();
+
+    /**
+     * @brief Get the first block of a slot
+     * @param slot_id ROM slot
+     */
+    static inline unsigned int get_slot_block(unsigned int slot_id) {
+        return slot_id * get_blocks_per_slot();
+    }
+
+    /**
+     * @brief Get the number of blocks of a slot
+     */
+    static inline unsigned int get_blocks_per_slot() {
+        return SLOT_SIZE / BLOCK_SIZE;
+    }
+
+    /**
+     * @brief Get the number of sectors of the chip
+     */
+    inline unsigned int get_nr_sectors() const {
+        return this->capacity / this->sector_size;
+    }
+
+    /**
+     * @brief Get the number of blocks of the chip
+     */
+    inline unsigned int get_nr_blocks() const {
+        return this->capacity / BLOCK_SIZE;
+    }
+
+    /**
+     * @brief Get the number of blocks of a sector
+     */
+    inline unsigned int get_blocks_per_sector() const {
+        return this->sector_size / BLOCK_SIZE;
+    }
+
+    /**
+     * @brief Get the number of slots that fit on the chip
+     */
+    inline unsigned int get_nr_slots() const {
+        return this->capacity / SLOT_SIZE;
+    }
+};
+
+#endif // CHIPDESCRIPTOR_H
@@ -0,0 +1,125 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "dumpthread.h"
+
+/**
+ * @brief dump the complete chip to file
+ */
+void DumpThread::run() {
+    this->serial_interface->set_cancellation_token(this->token);
+
+    // the capacity of the chip determines the size of the dump
+    unsigned int chip_id = 0;
+    try {
+        this->serial_interface->open_port();
+        chip_id = this->serial_interface->get_chip_id();
+    }  catch (std::exception& e) {
+        qCritical() << "Received error: " << e.what();
+        this->serial_interface->disconnect_port();
+        emit(dump_error(tr("Reading the chip id failed: %1").arg(this->get_error_message(e))));
+        return;
+    }
+    const ChipDescriptor* chip = ChipDescriptor::find(chip_id);
+    if(chip == nullptr) {
+        this->serial_interface->close_port();
+        emit(dump_error(tr("Unrecognized chip id: %1").arg(chip_id, 4, 16)));
+        return;
+    }
+    this->nr_blocks = chip->get_nr_blocks();
+    this->set_progress_total(this->nr_blocks);
+    emit(dump_started(this->nr_blocks));
+
+    // preallocate output file and map it into memory
+    QFile outfile(this->filename);
+    if(!outfile.open(QIODevice::ReadWrite | QIODevice::Truncate) || !outfile.resize(this->nr_blocks * ChipDescriptor::BLOCK_SIZE)) {
+        this->serial_interface->close_port();
+        emit(dump_error(tr("Could not open %1 for writing.").arg(this->filename)));
+        return;
+    }
+    uchar* dest = outfile.map(0, this->nr_blocks * ChipDescriptor::BLOCK_SIZE);
+    if(dest == nullptr) {
+        this->serial_interface->close_port();
+        emit(dump_error(tr("Could not map %1 into memory.").arg(this->filename)));
+        return;
+    }
+
+    // stream every block to its final position in the file while hashing per slot
+    const unsigned int blocks_per_slot = ChipDescriptor::get_blocks_per_slot();
+    std::vector<QByteArray> slot_hashes;
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    try {
+        this->serial_interface->stream_blocks(0, this->nr_blocks, [&](unsigned int block_id, const SerialResponseView& block) {
+            char* target = reinterpret_cast<char*>(dest + block_id * ChipDescriptor::BLOCK_SIZE);
+            block.copy_to(target);
+            hash.addData(target, block.size());
+            if((block_id + 1) % blocks_per_slot == 0) {
+                slot_hashes.push_back(hash.result());
+                hash.reset();
+            }
+            this->set_progress(block_id + 1);
+        });
+    }  catch (std::exception& e) {
+        qCritical() << "Received error: " << e.what();
+        outfile.unmap(dest);
+        outfile.close();
+        this->serial_interface->disconnect_port();
+        emit(dump_error(tr("Reading the chip failed: %1").arg(this->get_error_message(e))));
+        return;
+    }
+
+    outfile.unmap(dest);
+    outfile.close();
+    this->serial_interface->close_port();
+
+    this->write_index(chip_id, slot_hashes);
+
+    emit(dump_result_ready());
+}
+
+/**
+ * @brief Write sidecar index holding the per-slot hashes
+ * @param chip_id chip id
+ * @param slot_hashes hash per slot
+ */
+void DumpThread::write_index(unsigned int chip_id, const std::vector<QByteArray>& slot_hashes) {
+    QJsonArray slot_array;
+    for(unsigned int i=0; i<slot_hashes.size(); i++) {
+        QJsonObject slot;
+        slot["slot"] = (int)i;
+        slot["offset"] = (int)(i * ChipDescriptor::SLOT_SIZE);
+        slot["sha256"] = QString(slot_hashes[i].toHex());
+        slot_array.append(slot);
+    }
+
+    QJsonObject index;
+    index["image"] = QFileInfo(this->filename).fileName();
+    index["chip_id"] = QString("%1").arg(chip_id, 4, 16, QChar('0')).toUpper();
+    index["size"] = (int)(this->nr_blocks * ChipDescriptor::BLOCK_SIZE);
+    index["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    index["slots"] = slot_array;
+
+    QFile indexfile(this->filename + ".json");
+    if(indexfile.open(QIODevice::WriteOnly)) {
+        indexfile.write(QJsonDocument(index).toJson());
+    } else {
+        qCritical() << "Could not write index file " << indexfile.fileName();
+    }
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef DUMPTHREAD_H
+#define DUMPTHREAD_H
+
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+
+#include "ioworker.h"
+
+/**
+ * @brief Worker Thread dumping the complete flash chip of a cartridge to disk
+ *
+ * Rather than collecting the data in memory, the blocks are written into a
+ * memory-mapped output file at their final offset as they arrive. Next to
+ * the dump, a sidecar index (<dump>.json) is written which holds the
+ * SHA-256 hash of every slot.
+ */
+class DumpThread : public IOWorker {
+
+    Q_OBJECT
+
+private:
+    QString filename;               // output file
+    unsigned int nr_blocks = 0;     // number of blocks on the chip
+
+public:
+    DumpThread() {}
+
+    DumpThread(const std::shared_ptr<SerialInterface>& _serial_interface) :
+        IOWorker(_serial_interface) {}
+
+    /**
+     * @brief Set the output file
+     * @param _filename path to output file
+     */
+    inline void set_filename(const QString& _filename) {
+        this->filename = _filename;
+    }
+
+    /**
+     * @brief Get the number of blocks on the chip (known once dumping starts)
+     */
+    inline unsigned int get_nr_blocks() const {
+        return this->nr_blocks;
+    }
+
+    /**
+     * @brief dump the complete chip to file
+     */
+    void run() override;
+
+private:
+    /**
+     * @brief Write sidecar index holding the per-slot hashes
+     * @param chip_id chip id
+     * @param slot_hashes hash per slot
+     */
+    void write_index(unsigned int chip_id, const std::vector<QByteArray>& slot_hashes);
+
+signals:
+    /**
+     * @brief signal when the chip has been identified and dumping starts
+     * @param nr_blocks number of blocks to read
+     */
+    void dump_started(unsigned int nr_blocks);
+
+    /**
+     * @brief signal when the dump is complete
+     */
+    void dump_result_ready();
+
+    /**
+     * @brief signal when the dump could not be made
+     * @param message error message
+     */
+    void dump_error(const QString& message);
+};
+
+#endif // DUMPTHREAD_H
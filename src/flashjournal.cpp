@@ -0,0 +1,170 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "flashjournal.h"
+
+/**
+ * @brief Constructor
+ * @param _slot_id ROM slot
+ * @param image image that is flashed to the slot
+ * @param _device port of the cartridge reader
+ */
+FlashJournal::FlashJournal(unsigned int _slot_id, const QByteArray& image, const QString& _device) :
+    slot_id(_slot_id),
+    device(_device),
+    image_hash(QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex())
+{
+    this->filename = this->get_filename();
+}
+
+/**
+ * @brief Destructor, saves pending progress
+ */
+FlashJournal::~FlashJournal() {
+    this->flush();
+}
+
+/**
+ * @brief Load the journal of the slot from disk
+ * @return whether a journal for the same image was found
+ */
+bool FlashJournal::load() {
+    this->erased.clear();
+    this->written.clear();
+
+    QFile infile(this->filename);
+    if(!infile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonObject journal = QJsonDocument::fromJson(infile.readAll()).object();
+    if(journal["image"].toString() != QString(this->image_hash) || journal["slot"].toInt() != (int)this->slot_id ||
+       journal["device"].toString() != this->device) {
+        qDebug() << "Discarding journal of slot " << this->slot_id << " for a different image.";
+        return false;
+    }
+
+    for(const auto& value : journal["erased"].toArray()) {
+        this->erased.insert(value.toInt());
+    }
+    for(const auto& value : journal["written"].toArray()) {
+        this->written.insert(value.toInt());
+    }
+
+    qDebug() << "Loaded journal of slot " << this->slot_id << ": " << this->erased.size()
+             << " sectors erased, " << this->written.size() << " blocks written.";
+
+    return true;
+}
+
+/**
+ * @brief Record that a sector has been erased
+ * @param first_block first block of the sector (relative to slot)
+ */
+void FlashJournal::mark_erased(unsigned int first_block, unsigned int nr_blocks) {
+    this->erased.insert(first_block);
+    for(unsigned int i=first_block; i<first_block + nr_blocks; i++) {
+        this->written.erase(i);
+    }
+    this->save();
+}
+
+/**
+ * @brief Record that a block has been written and verified
+ * @param block_id block (relative to slot)
+ */
+void FlashJournal::mark_written(unsigned int block_id) {
+    this->written.insert(block_id);
+    this->dirty = true;
+    if(!this->save_timer.isValid() || this->save_timer.elapsed() >= SAVE_INTERVAL) {
+        this->save();
+    }
+}
+
+/**
+ * @brief Save pending progress to disk
+ */
+void FlashJournal::flush() {
+    if(this->dirty) {
+        this->save();
+    }
+}
+
+/**
+ * @brief Discard all progress (in memory and on disk)
+ */
+void FlashJournal::clear() {
+    this->erased.clear();
+    this->written.clear();
+    this->remove();
+}
+
+/**
+ * @brief Remove the journal from disk, e.g. after a completed job
+ */
+void FlashJournal::remove() {
+    this->dirty = false;
+    QFile::remove(this->filename);
+}
+
+/**
+ * @brief Store the journal on disk
+ */
+void FlashJournal::save() {
+    QJsonArray erased_array;
+    for(unsigned int first_block : this->erased) {
+        erased_array.append((int)first_block);
+    }
+
+    QJsonArray written_array;
+    for(unsigned int block_id : this->written) {
+        written_array.append((int)block_id);
+    }
+
+    QJsonObject journal;
+    journal["slot"] = (int)this->slot_id;
+    journal["device"] = this->device;
+    journal["image"] = QString(this->image_hash);
+    journal["erased"] = erased_array;
+    journal["written"] = written_array;
+
+    // write atomically such that an interruption never leaves a corrupt journal
+    QDir().mkpath(QFileInfo(this->filename).path());
+    QSaveFile outfile(this->filename);
+    if(outfile.open(QIODevice::WriteOnly)) {
+        outfile.write(QJsonDocument(journal).toJson(QJsonDocument::Compact));
+        outfile.commit();
+    } else {
+        qCritical() << "Could not write flash journal " << this->filename;
+    }
+
+    this->dirty = false;
+    this->save_timer.start();
+}
+
+/**
+ * @brief Path of the journal file of the slot on this reader
+ */
+QString FlashJournal::get_filename() const {
+    QString device_dir = this->device;
+    device_dir.replace(QRegularExpression("[^A-Za-z0-9]"), "_");
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/journal/" + device_dir;
+    return path + QString("/slot%1.json").arg(this->slot_id, 2, 10, QChar('0'));
+}
@@ -0,0 +1,160 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef FLASHJOURNAL_H
+#define FLASHJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QRegularExpression>
+#include <QDebug>
+
+#include <set>
+
+/**
+ * @brief On-disk progress journal of a flash job
+ *
+ * The journal records which sectors of a slot have been erased and which
+ * blocks have been written and verified for a specific image. When a flash
+ * job is interrupted, a new job for the same slot and image can resume from
+ * the journal without repeating completed erases and burns.
+ *
+ * Journals are stored per reader and slot in the application data folder,
+ * such that readers flashing the same slot concurrently (FlashScheduler)
+ * each keep their own journal. Written
+ * blocks are saved at most once per SAVE_INTERVAL, such that recording
+ * progress does not hold up the flash pipeline; erased sectors are saved
+ * right away. Pending progress is saved by flush() and upon destruction,
+ * e.g. when a flash job is aborted by an error.
+ */
+class FlashJournal {
+
+private:
+    static const qint64 SAVE_INTERVAL = 1000;   // minimum interval (ms) between saves of written blocks
+
+    unsigned int slot_id;               // ROM slot
+    QString device;                     // port of the cartridge reader
+    QByteArray image_hash;              // SHA-256 of the image that is flashed
+    std::set<unsigned int> erased;      // erased sectors (first block, relative to slot)
+    std::set<unsigned int> written;     // written and verified blocks (relative to slot)
+    QString filename;                   // path of the journal file
+    bool dirty = false;                 // progress has not been saved yet
+    QElapsedTimer save_timer;           // time since the last save
+
+public:
+    /**
+     * @brief Constructor
+     * @param _slot_id ROM slot
+     * @param image image that is flashed to the slot
+     * @param _device port of the cartridge reader
+     */
+    FlashJournal(unsigned int _slot_id, const QByteArray& image, const QString& _device);
+
+    /**
+     * @brief Destructor, saves pending progress
+     */
+    ~FlashJournal();
+
+    /**
+     * @brief Load the journal of the slot from disk
+     * @return whether a journal for the same image was found
+     */
+    bool load();
+
+    /**
+     * @brief Whether the journal holds any progress
+     */
+    inline bool is_empty() const {
+        return this->erased.empty() && this->written.empty();
+    }
+
+    /**
+     * @brief Whether the sector starting at block was erased
+     */
+    inline bool is_erased(unsigned int first_block) const {
+        return this->erased.count(first_block) > 0;
+    }
+
+    /**
+     * @brief Whether the block was written and verified
+     */
+    inline bool is_written(unsigned int block_id) const {
+        return this->written.count(block_id) > 0;
+    }
+
+    /**
+     * @brief Get the written and verified blocks
+     */
+    inline const auto& get_written_blocks() const {
+        return this->written;
+    }
+
+    /**
+     * @brief Record that a sector has been erased
+     * @param first_block first block of the sector (relative to slot)
+     *
+     * Erasing a sector invalidates the blocks previously written to it.
+     */
+    void mark_erased(unsigned int first_block, unsigned int nr_blocks);
+
+    /**
+     * @brief Record that a block has been written and verified
+     * @param block_id block (relative to slot)
+     */
+    void mark_written(unsigned int block_id);
+
+    /**
+     * @brief Save pending progress to disk
+     */
+    void flush();
+
+    /**
+     * @brief Discard all progress (in memory and on disk)
+     */
+    void clear();
+
+    /**
+     * @brief Remove the journal from disk, e.g. after a completed job
+     */
+    void remove();
+
+private:
+    /**
+     * @brief Store the journal on disk
+     */
+    void save();
+
+    /**
+     * @brief Path of the journal file of the slot on this reader
+     */
+    QString get_filename() const;
+};
+
+#endif // FLASHJOURNAL_H
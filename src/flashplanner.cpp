@@ -0,0 +1,108 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "flashplanner.h"
+
+/**
+ * @brief Construct a plan
+ * @param current current contents of the flash
+ * @param target contents that should be written, multiple of BLOCK_SIZE
+ * @param sector_size size of an erasable sector of the chip
+ */
+FlashPlanner::FlashPlanner(const QByteArray& current, const QByteArray& target, unsigned int sector_size) {
+    const unsigned int nr_blocks = target.size() / BLOCK_SIZE;
+    const unsigned int blocks_per_sector = sector_size / BLOCK_SIZE;
+    const bool current_known = current.size() >= target.size();
+
+    for(unsigned int i=0; i<nr_blocks; i+=blocks_per_sector) {
+        SectorPlan sector;
+        sector.first_block = i;
+        sector.nr_blocks = std::min(blocks_per_sector, nr_blocks - i);
+
+        const QByteArray sector_target = target.mid(i * BLOCK_SIZE, sector.nr_blocks * BLOCK_SIZE);
+        const QByteArray sector_current = current.mid(i * BLOCK_SIZE, sector.nr_blocks * BLOCK_SIZE);
+        sector.action = current_known ? classify(sector_current, sector_target) : SectorAction::ERASE_PROGRAM;
+
+        for(unsigned int j=0; j<sector.nr_blocks; j++) {
+            const unsigned int offset = j * BLOCK_SIZE;
+            switch(sector.action) {
+                case SectorAction::UNCHANGED:
+                break;
+                case SectorAction::PROGRAM:
+                    // only burn the blocks that actually change
+                    if(sector_current.mid(offset, BLOCK_SIZE) != sector_target.mid(offset, BLOCK_SIZE)) {
+                        sector.blocks.push_back(i + j);
+                    }
+                break;
+                case SectorAction::ERASE_PROGRAM:
+                    // an erased block already reads 0xFF, no need to transfer blank blocks
+                    if(!is_blank(sector_target.mid(offset, BLOCK_SIZE))) {
+                        sector.blocks.push_back(i + j);
+                    }
+                break;
+            }
+        }
+
+        if(sector.action == SectorAction::ERASE_PROGRAM) {
+            this->nr_erases++;
+        }
+        this->nr_burns += sector.blocks.size();
+        this->sectors.push_back(sector);
+    }
+
+    qDebug() << "Flash plan: " << this->sectors.size() << " sectors, "
+             << this->nr_erases << " erases, " << this->nr_burns << " burns.";
+}
+
+/**
+ * @brief Check whether a block only contains 0xFF bytes (erased state)
+ * @param block block data
+ * @return whether the block is blank
+ */
+bool FlashPlanner::is_blank(const QByteArray& block) {
+    for(int i=0; i<block.size(); i++) {
+        if((uint8_t)block[i] != 0xFF) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Classify a single sector
+ * @param current current contents of the sector
+ * @param target target contents of the sector
+ * @return sector action
+ */
+FlashPlanner::SectorAction FlashPlanner::classify(const QByteArray& current, const QByteArray& target) {
+    if(current == target) {
+        return SectorAction::UNCHANGED;
+    }
+
+    // programming can only clear bits; any bit going from 0 to 1 requires an erase
+    for(int i=0; i<target.size(); i++) {
+        if(((uint8_t)current[i] & (uint8_t)target[i]) != (uint8_t)target[i]) {
+            return SectorAction::ERASE_PROGRAM;
+        }
+    }
+
+    return SectorAction::PROGRAM;
+}
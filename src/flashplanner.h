@@ -0,0 +1,122 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef FLASHPLANNER_H
+#define FLASHPLANNER_H
+
+#include <QByteArray>
+#include <QDebug>
+#include <vector>
+
+#include "chipdescriptor.h"
+
+/**
+ * @brief Plans the erase and program operations for a SST39SF0x0 flash
+ *
+ * A NOR flash cell can be programmed from 1 to 0 without erasing, only
+ * returning a bit from 0 to 1 requires an erase of the complete sector.
+ * The planner compares the current contents with the target contents per
+ * sector and classifies every sector as unchanged, program-only or
+ * erase and program. Blocks of an erased sector that only contain 0xFF
+ * are not burned.
+ */
+class FlashPlanner {
+
+public:
+    enum class SectorAction {
+        UNCHANGED,          // sector already holds the target data
+        PROGRAM,            // all changed bits go from 1 to 0, no erase needed
+        ERASE_PROGRAM,      // sector needs to be erased prior to programming
+    };
+
+    struct SectorPlan {
+        unsigned int first_block = 0;       // first block (relative to data) of the sector
+        unsigned int nr_blocks = 0;         // number of blocks of the sector covered by the data
+        SectorAction action = SectorAction::ERASE_PROGRAM;
+        std::vector<unsigned int> blocks;   // blocks (relative to data) that need to be burned
+    };
+
+    // rough timing estimates of the cartridge reader, used for predictions
+    static constexpr double ERASE_TIME = 0.030;     // seconds per sector erase
+    static constexpr double BURN_TIME = 0.012;      // seconds per block burn
+
+    static const unsigned int BLOCK_SIZE = ChipDescriptor::BLOCK_SIZE;
+
+private:
+    std::vector<SectorPlan> sectors;
+    unsigned int nr_erases = 0;
+    unsigned int nr_burns = 0;
+
+public:
+    /**
+     * @brief Construct a plan
+     * @param current current contents of the flash; when this does not cover
+     *        the target, every sector is erased and programmed
+     * @param target contents that should be written, multiple of BLOCK_SIZE
+     * @param sector_size size of an erasable sector of the chip
+     */
+    FlashPlanner(const QByteArray& current, const QByteArray& target, unsigned int sector_size = 0x1000);
+
+    /**
+     * @brief Get the plan of all sectors covered by the target
+     */
+    inline const auto& get_sectors() const {
+        return this->sectors;
+    }
+
+    /**
+     * @brief Number of sector erases in the plan
+     */
+    inline unsigned int get_nr_erases() const {
+        return this->nr_erases;
+    }
+
+    /**
+     * @brief Number of block burns in the plan
+     */
+    inline unsigned int get_nr_burns() const {
+        return this->nr_burns;
+    }
+
+    /**
+     * @brief Predicted time (in seconds) to execute the plan
+     */
+    inline double get_predicted_time() const {
+        return this->nr_erases * ERASE_TIME + this->nr_burns * BURN_TIME;
+    }
+
+    /**
+     * @brief Check whether a block only contains 0xFF bytes (erased state)
+     * @param block block data
+     * @return whether the block is blank
+     */
+    static bool is_blank(const QByteArray& block);
+
+private:
+    /**
+     * @brief Classify a single sector
+     * @param current current contents of the sector
+     * @param target target contents of the sector
+     * @return sector action
+     */
+    static SectorAction classify(const QByteArray& current, const QByteArray& target);
+};
+
+#endif // FLASHPLANNER_H
@@ -0,0 +1,255 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "flashscheduler.h"
+
+/**
+ * @brief Constructor
+ */
+FlashScheduler::FlashScheduler(QObject* parent) :
+    QObject(parent),
+    progress_timer(this) {
+    this->progress_timer.setInterval(PROGRESS_INTERVAL);
+    connect(&this->progress_timer, SIGNAL(timeout()), this, SLOT(slot_sample_progress()));
+}
+
+/**
+ * @brief Destructor, waits for all devices to finish
+ */
+FlashScheduler::~FlashScheduler() {
+    for(auto& device : this->devices) {
+        if(device.flashthread) {
+            device.flashthread->wait();
+        }
+    }
+}
+
+/**
+ * @brief Add a cartridge reader
+ * @param portname port address
+ * @param baudrate communication speed
+ */
+void FlashScheduler::add_device(const std::string& portname, int baudrate) {
+    Device device;
+    device.portname = portname;
+    device.serial_interface = std::make_shared<SerialInterface>(portname, baudrate);
+    this->devices.push_back(std::move(device));
+}
+
+/**
+ * @brief Queue the contents of a single cartridge
+ * @param jobs slots and their data
+ * @return job id
+ */
+unsigned int FlashScheduler::add_job(const std::vector<FlashJob>& jobs) {
+    this->queue.emplace_back(this->nr_jobs, jobs);
+    return this->nr_jobs++;
+}
+
+/**
+ * @brief Whether any device is still flashing or jobs are pending
+ */
+bool FlashScheduler::is_running() const {
+    if(!this->queue.empty()) {
+        return true;
+    }
+
+    for(const auto& device : this->devices) {
+        if(device.state == DeviceState::BUSY) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Assign jobs to all idle devices
+ */
+void FlashScheduler::start() {
+    this->progress_timer.start();
+    for(unsigned int i=0; i<this->devices.size(); i++) {
+        if(this->devices[i].state == DeviceState::IDLE) {
+            this->dispatch(i);
+        }
+    }
+}
+
+/**
+ * @brief Discard all pending jobs and cancel the jobs in progress
+ */
+void FlashScheduler::cancel() {
+    this->queue.clear();
+    for(auto& device : this->devices) {
+        if(device.state == DeviceState::BUSY) {
+            device.flashthread->cancel();
+        }
+    }
+
+    this->check_finished();
+}
+
+/**
+ * @brief Allow a held device to take the next job, e.g. after its cartridge was swapped
+ * @param device_id device
+ */
+void FlashScheduler::release_device(unsigned int device_id) {
+    if(this->devices[device_id].state == DeviceState::HOLD) {
+        this->devices[device_id].state = DeviceState::IDLE;
+        this->dispatch(device_id);
+        this->check_finished();
+    }
+}
+
+/**
+ * @brief Start the next pending job on a device
+ * @param device_id device
+ */
+void FlashScheduler::dispatch(unsigned int device_id) {
+    if(this->queue.empty()) {
+        return;
+    }
+
+    Device& device = this->devices[device_id];
+    auto job = this->queue.front();
+    this->queue.pop_front();
+
+    // the previous thread has emitted its result, but may not have returned from run() yet
+    if(device.flashthread) {
+        device.flashthread->wait();
+    }
+
+    device.flashthread = std::make_unique<FlashThread>(device.serial_interface);
+    device.flashthread->set_serial_port(device.portname);
+    device.flashthread->set_differential(this->differential);
+    for(const auto& slot : job.second) {
+        device.flashthread->add_job(slot.slot_id, slot.data, slot.reference);
+    }
+    device.state = DeviceState::BUSY;
+    device.job_id = job.first;
+
+    connect(device.flashthread.get(), SIGNAL(flash_result_ready()), this, SLOT(slot_result_ready()));
+    connect(device.flashthread.get(), SIGNAL(flash_interrupted(const QString&)), this, SLOT(slot_interrupted(const QString&)));
+    connect(device.flashthread.get(), SIGNAL(flash_chip_id_error(uint)), this, SLOT(slot_chip_id_error(uint)));
+
+    qInfo() << "Flashing job" << job.first << "on" << device.portname.c_str();
+    emit(device_job_started(device_id, job.first));
+    emit(device_progress(device_id, 0, device.flashthread->get_nr_blocks()));
+    device.flashthread->start();
+}
+
+/**
+ * @brief Conclude the job on a device
+ * @param device_id device
+ * @param success whether the cartridge was flashed and verified
+ * @param message description of the result
+ */
+void FlashScheduler::finish(unsigned int device_id, bool success, const QString& message) {
+    Device& device = this->devices[device_id];
+    qInfo() << "Job" << device.job_id << "on" << device.portname.c_str() << (success ? "succeeded:" : "failed:") << message;
+
+    if(success) {
+        this->nr_success++;
+    } else {
+        this->nr_failed++;
+    }
+    emit(device_progress(device_id, device.flashthread->get_nr_blocks_done(), device.flashthread->get_nr_blocks()));
+
+    // a device needs a fresh cartridge before it can take the next job
+    device.state = this->queue.empty() ? DeviceState::IDLE : DeviceState::HOLD;
+    emit(device_job_finished(device_id, device.job_id, success, message, device.state == DeviceState::HOLD));
+    device.job_id = -1;
+
+    this->check_finished();
+}
+
+/**
+ * @brief Signal when all jobs are done and no device awaits a cartridge swap
+ */
+void FlashScheduler::check_finished() {
+    if(!this->is_running() && std::none_of(this->devices.begin(), this->devices.end(),
+                                           [](const Device& d){return d.state == DeviceState::HOLD;})) {
+        this->progress_timer.stop();
+        emit(scheduler_finished(this->nr_success, this->nr_failed));
+    }
+}
+
+/**
+ * @brief Find the device that runs the thread that sent a signal
+ * @return device id or -1 when not found
+ */
+int FlashScheduler::find_device(QObject* thread) const {
+    for(unsigned int i=0; i<this->devices.size(); i++) {
+        if(this->devices[i].flashthread.get() == thread) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Slot to sample the progress of all busy devices
+ */
+void FlashScheduler::slot_sample_progress() {
+    for(unsigned int i=0; i<this->devices.size(); i++) {
+        const Device& device = this->devices[i];
+        if(device.state == DeviceState::BUSY) {
+            emit(device_progress(i, device.flashthread->get_nr_blocks_done(), device.flashthread->get_nr_blocks()));
+        }
+    }
+}
+
+/**
+ * @brief Slot accepting that a device has finished flashing
+ */
+void FlashScheduler::slot_result_ready() {
+    int device_id = this->find_device(this->sender());
+    if(device_id < 0) {
+        return;
+    }
+
+    const auto& failed_blocks = this->devices[device_id].flashthread->get_failed_blocks();
+    if(failed_blocks.empty()) {
+        this->finish(device_id, true, tr("Flashed and verified."));
+    } else {
+        this->finish(device_id, false, tr("%1 blocks could not be verified.").arg(failed_blocks.size()));
+    }
+}
+
+/**
+ * @brief Slot accepting that a device was interrupted by an error
+ */
+void FlashScheduler::slot_interrupted(const QString& error_msg) {
+    int device_id = this->find_device(this->sender());
+    if(device_id >= 0) {
+        this->finish(device_id, false, error_msg);
+    }
+}
+
+/**
+ * @brief Slot accepting that a device holds a cartridge with a wrong chip
+ */
+void FlashScheduler::slot_chip_id_error(unsigned int chip_id) {
+    int device_id = this->find_device(this->sender());
+    if(device_id >= 0) {
+        this->finish(device_id, false, tr("Invalid chip id (%1).").arg(chip_id, 0, 16));
+    }
+}
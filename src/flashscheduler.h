@@ -0,0 +1,221 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef FLASHSCHEDULER_H
+#define FLASHSCHEDULER_H
+
+#include <QObject>
+#include <QDebug>
+#include <QTimer>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "flashthread.h"
+
+/**
+ * @brief Distributes flash jobs over multiple cartridge readers
+ *
+ * Every device (port) runs its own FlashThread with its own SerialInterface,
+ * such that all readers flash concurrently. A job describes the contents of
+ * a single cartridge, i.e. one or more (slot, image) pairs. Free devices take
+ * the next job from a shared queue.
+ *
+ * Once a device has finished a job while more jobs are pending, it is held
+ * until release_device is called, i.e. until the operator has swapped the
+ * cartridge.
+ */
+class FlashScheduler : public QObject {
+
+    Q_OBJECT
+
+public:
+    enum class DeviceState {
+        IDLE,
+        BUSY,
+        HOLD,
+    };
+
+private:
+    struct Device {
+        std::string portname;
+        std::shared_ptr<SerialInterface> serial_interface;
+        std::unique_ptr<FlashThread> flashthread;
+        DeviceState state = DeviceState::IDLE;
+        int job_id = -1;                // job that is currently flashed
+    };
+
+    std::vector<Device> devices;                        // cartridge readers
+    std::deque<std::pair<unsigned int, std::vector<FlashJob>>> queue;  // pending jobs
+    unsigned int nr_jobs = 0;           // number of submitted jobs
+    unsigned int nr_success = 0;        // number of successfully flashed cartridges
+    unsigned int nr_failed = 0;         // number of failed cartridges
+    bool differential = false;          // only erase and burn sectors that differ
+    QTimer progress_timer;              // samples the progress of the busy devices
+
+    static const int PROGRESS_INTERVAL = 200;   // ms between progress samples
+
+public:
+    /**
+     * @brief Constructor
+     */
+    FlashScheduler(QObject* parent = nullptr);
+
+    /**
+     * @brief Destructor, waits for all devices to finish
+     */
+    ~FlashScheduler();
+
+    /**
+     * @brief Add a cartridge reader
+     * @param portname port address
+     * @param baudrate communication speed
+     */
+    void add_device(const std::string& portname, int baudrate = 115200);
+
+    /**
+     * @brief Get the number of cartridge readers
+     */
+    inline unsigned int get_nr_devices() const {
+        return this->devices.size();
+    }
+
+    /**
+     * @brief Get the port address of a cartridge reader
+     */
+    inline const std::string& get_device_port(unsigned int device_id) const {
+        return this->devices[device_id].portname;
+    }
+
+    /**
+     * @brief Enable or disable differential flashing on all devices
+     */
+    inline void set_differential(bool _differential) {
+        this->differential = _differential;
+    }
+
+    /**
+     * @brief Queue the contents of a single cartridge
+     * @param jobs slots and their data
+     * @return job id
+     */
+    unsigned int add_job(const std::vector<FlashJob>& jobs);
+
+    /**
+     * @brief Whether any device is still flashing or jobs are pending
+     */
+    bool is_running() const;
+
+    /**
+     * @brief Assign jobs to all idle devices
+     */
+    void start();
+
+    /**
+     * @brief Discard all pending jobs and cancel the jobs in progress
+     */
+    void cancel();
+
+    /**
+     * @brief Allow a held device to take the next job, e.g. after its cartridge was swapped
+     * @param device_id device
+     */
+    void release_device(unsigned int device_id);
+
+private:
+    /**
+     * @brief Start the next pending job on a device
+     * @param device_id device
+     */
+    void dispatch(unsigned int device_id);
+
+    /**
+     * @brief Conclude the job on a device
+     * @param device_id device
+     * @param success whether the cartridge was flashed and verified
+     * @param message description of the result
+     */
+    void finish(unsigned int device_id, bool success, const QString& message);
+
+    /**
+     * @brief Signal when all jobs are done and no device awaits a cartridge swap
+     */
+    void check_finished();
+
+    /**
+     * @brief Find the device that runs the thread that sent a signal
+     * @return device id or -1 when not found
+     */
+    int find_device(QObject* thread) const;
+
+signals:
+    /**
+     * @brief signal when a device makes progress
+     * @param device_id device
+     * @param nr_blocks_done number of blocks processed
+     * @param nr_blocks number of blocks of the job
+     */
+    void device_progress(unsigned int device_id, unsigned int nr_blocks_done, unsigned int nr_blocks);
+
+    /**
+     * @brief signal when a device starts a job
+     */
+    void device_job_started(unsigned int device_id, unsigned int job_id);
+
+    /**
+     * @brief signal when a device has finished a job
+     * @param device_id device
+     * @param job_id job
+     * @param success whether the cartridge was flashed and verified
+     * @param message description of the result
+     * @param hold whether the device waits for release_device
+     */
+    void device_job_finished(unsigned int device_id, unsigned int job_id, bool success, const QString& message, bool hold);
+
+    /**
+     * @brief signal when all jobs are finished
+     */
+    void scheduler_finished(unsigned int nr_success, unsigned int nr_failed);
+
+private slots:
+    /**
+     * @brief Slot to sample the progress of all busy devices
+     */
+    void slot_sample_progress();
+
+    /**
+     * @brief Slot accepting that a device has finished flashing
+     */
+    void slot_result_ready();
+
+    /**
+     * @brief Slot accepting that a device was interrupted by an error
+     */
+    void slot_interrupted(const QString& error_msg);
+
+    /**
+     * @brief Slot accepting that a device holds a cartridge with a wrong chip
+     */
+    void slot_chip_id_error(unsigned int chip_id);
+};
+
+#endif // FLASHSCHEDULER_H
@@ -19,44 +19,373 @@
  ****************************************************************************/
 
 #include "flashthread.h"
+#include "trace.h"
 
 /**
  * @brief run cart flash routine
  */
 void FlashThread::run() {
-    this->flash_sst39sf0x0();
+    try {
+        this->serial_interface->set_cancellation_token(this->token);
+        this->flash_sst39sf0x0();
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        this->serial_interface->disconnect_port();
+        emit(flash_interrupted(this->get_error_message(e)));
+    }
+}
+
+/**
+ * @brief Get the total number of blocks of all jobs
+ */
+unsigned int FlashThread::get_nr_blocks() const {
+    unsigned int nr_blocks = 0;
+    for(const auto& job : this->jobs) {
+        nr_blocks += job.data.size() / ChipDescriptor::BLOCK_SIZE;
+    }
+    return nr_blocks;
 }
 
 /**
  * @brief run flash cart routine for a sst39sf0x0 chip
  */
 void FlashThread::flash_sst39sf0x0() {
+    this->set_progress_total(this->get_nr_blocks());
     this->serial_interface->open_port();
 
     // check that the chip id is correct
     unsigned int chip_id = this->serial_interface->get_chip_id();
-    if(!(chip_id == 0xBFB5 || chip_id == 0xBFB6 || chip_id == 0xBFB7)) {
+    const ChipDescriptor* chip = ChipDescriptor::find(chip_id);
+    if(chip == nullptr) {
+        this->serial_interface->close_port();
         emit(flash_chip_id_error(chip_id));
         return;
     }
 
-    for(unsigned int i=0; i<(this->data.size() / 0x100); i++) {
-        emit(flash_block_start(i));
+    // process the slots in address order such that the cartridge is traversed only once
+    std::sort(this->jobs.begin(), this->jobs.end(), [](const FlashJob& a, const FlashJob& b) {
+        return a.slot_id < b.slot_id;
+    });
 
-        if(i % (0x1000 / 256) == 0) {
-            this->serial_interface->erase_sector(this->slot_id * 64 + i);
+    // plan all jobs up front to provide a single estimate for the whole batch
+    std::vector<FlashJournal> journals;
+    std::vector<std::set<unsigned int>> verified_blocks;   // blocks per job confirmed on the chip
+    std::vector<std::vector<FlashPlanner::SectorPlan>> plans;
+    std::set<unsigned int> erase_sectors;   // sectors (relative to chip) that are erased
+    unsigned int nr_erases = 0;
+    unsigned int nr_burns = 0;
+    for(auto& job : this->jobs) {
+        unsigned int nr_blocks = job.data.size() / ChipDescriptor::BLOCK_SIZE;
+        const unsigned int first_block = ChipDescriptor::get_slot_block(job.slot_id);
+        if(first_block + nr_blocks > chip->get_nr_blocks()) {
+            throw std::runtime_error(QString("Slot %1 exceeds the capacity of the %2 chip.").arg(job.slot_id + 1).arg(chip->name).toStdString());
         }
 
-        try {
-           this->serial_interface->burn_block(this->slot_id * 64 + i, this->data.mid(i * 256, 256));
-        }  catch (std::exception& e) {
-           qCritical() << "Received error: " << e.what();
+        // obtain current slot contents when these are not known, preferably from the slot cache
+        if(this->differential && job.reference.size() < job.data.size()) {
+            TRACE_DEBUG(trace_flash) << "Reading slot " << job.slot_id << " for differential flash.";
+            const unsigned int blocks_per_slot = ChipDescriptor::get_blocks_per_slot();
+            job.reference.clear();
+            for(unsigned int i=0; i<nr_blocks; i+=blocks_per_slot) {
+                bool from_cache = false;
+                job.reference.append(this->read_slot(chip_id, job.slot_id + i / blocks_per_slot,
+                                                     std::min(blocks_per_slot, nr_blocks - i), from_cache));
+            }
+        }
+
+        // pick up the progress of an interrupted job, provided the cartridge agrees with it
+        journals.emplace_back(job.slot_id, job.data, QString::fromStdString(this->portname));
+        FlashJournal& journal = journals.back();
+        verified_blocks.emplace_back();
+        if(!(this->resume && journal.load() && this->check_journal(job, journal, verified_blocks.back()))) {
+            journal.clear();
+            verified_blocks.back().clear();
+        }
+
+        // plan which sectors need to be erased and which blocks need to be burned
+        FlashPlanner planner(this->differential ? job.reference : QByteArray(), job.data, chip->sector_size);
+        plans.push_back(planner.get_sectors());
+        for(auto& sector : plans.back()) {
+            if(sector.action == FlashPlanner::SectorAction::ERASE_PROGRAM && journal.is_erased(sector.first_block)) {
+                sector.action = FlashPlanner::SectorAction::PROGRAM;
+            }
+
+            // journaled blocks are only skipped when their sector is not erased again
+            if(sector.action == FlashPlanner::SectorAction::ERASE_PROGRAM) {
+                for(unsigned int i=sector.first_block; i<sector.first_block + sector.nr_blocks; i++) {
+                    verified_blocks.back().erase(i);
+                }
+            } else {
+                sector.blocks.erase(std::remove_if(sector.blocks.begin(), sector.blocks.end(),
+                                                   [&journal](unsigned int i){return journal.is_written(i);}),
+                                    sector.blocks.end());
+            }
+
+            if(sector.action == FlashPlanner::SectorAction::ERASE_PROGRAM) {
+                erase_sectors.insert((first_block + sector.first_block) / chip->get_blocks_per_sector());
+                nr_erases++;
+            }
+            nr_burns += sector.blocks.size();
+        }
+    }
+
+    // when every sector of the chip is rewritten, a single chip erase replaces all sector erases
+    const bool chip_erase = erase_sectors.size() == chip->get_nr_sectors();
+    if(chip_erase) {
+        nr_erases = 1;
+    }
+    const double erase_time = chip_erase ? chip->chip_erase_time / 1000.0 : nr_erases * FlashPlanner::ERASE_TIME;
+    emit(flash_plan_ready(nr_erases, nr_burns, erase_time + nr_burns * FlashPlanner::BURN_TIME));
+
+    if(chip_erase) {
+        TRACE_INFO(trace_flash) << "Erasing complete " << chip->name << " chip.";
+        this->serial_interface->erase_chip(chip->chip_erase_time);
+
+        // the chip erase is not acknowledged by the board, hence only rely on it once
+        // the chip reads back as erased; otherwise the sectors are erased one by one
+        if(this->check_chip_erased(chip)) {
+            for(unsigned int j=0; j<this->jobs.size(); j++) {
+                for(auto& sector : plans[j]) {
+                    if(sector.action == FlashPlanner::SectorAction::ERASE_PROGRAM) {
+                        journals[j].mark_erased(sector.first_block, sector.nr_blocks);
+                        sector.action = FlashPlanner::SectorAction::PROGRAM;
+                    }
+                }
+            }
+        } else {
+            TRACE_WARNING(trace_flash) << "Chip erase could not be confirmed, erasing sectors individually.";
+        }
+    }
+
+    // all erase and burn commands of a job are queued at once, such that the board
+    // proceeds with the next command as soon as the previous one is finished
+    unsigned int page_offset = 0;
+    for(unsigned int j=0; j<this->jobs.size(); j++) {
+        const FlashJob& job = this->jobs[j];
+        FlashJournal& journal = journals[j];
+        const unsigned int nr_blocks = job.data.size() / ChipDescriptor::BLOCK_SIZE;
+        const unsigned int first_block = ChipDescriptor::get_slot_block(job.slot_id);
+        emit(flash_job_start(j, job.slot_id));
+
+        // report progress up to and including a block once its command is finished
+        auto advance = [this, page_offset](unsigned int block_id) {
+            if(page_offset + block_id + 1 > this->get_nr_blocks_done()) {
+                this->set_progress(page_offset + block_id + 1);
+            }
+        };
+
+        std::set<unsigned int>& verified = verified_blocks[j];   // blocks (relative to slot) confirmed on the chip
+        std::set<unsigned int> mismatched;    // blocks (relative to slot) that failed verification
+        for(const auto& sector : plans[j]) {
+            if(sector.action == FlashPlanner::SectorAction::ERASE_PROGRAM) {
+                this->serial_interface->queue_erase_sector(first_block + sector.first_block, [&journal, sector]() {
+                    journal.mark_erased(sector.first_block, sector.nr_blocks);
+                });
+            }
+
+            for(unsigned int i : sector.blocks) {
+                const QByteArray block = job.data.mid(i * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE);
+                const uint16_t crc = qChecksum(block.constData(), block.size());
+                this->serial_interface->queue_burn_block_verify(first_block + i, block,
+                                                                [&, i, crc](bool acknowledged, uint16_t crc_chip) {
+                    if(acknowledged && crc_chip == crc) {
+                        journal.mark_written(i);
+                        verified.insert(i);
+                    } else {
+                        TRACE_WARNING(trace_flash) << "CRC mismatch on block " << i << ": " << crc_chip << " versus " << crc;
+                        mismatched.insert(i);
+                    }
+                    advance(i);
+                });
+            }
         }
+        this->serial_interface->wait_for_queue();
+        journal.flush();
+
+        // blocks that were not burned (unchanged sectors, blank blocks) are read back
+        // as well, such that a stale reference is never reported as a verified flash
+        this->verify_unburned_blocks(job, verified, mismatched);
 
-        emit(flash_block_done(i));
+        // programming can only clear bits, hence a sector holding a mismatching block is
+        // erased and programmed again as a whole
+        const unsigned int blocks_per_sector = chip->get_blocks_per_sector();
+        std::set<unsigned int> retry_sectors;
+        for(unsigned int i : mismatched) {
+            retry_sectors.insert(i / blocks_per_sector * blocks_per_sector);
+        }
+        for(unsigned int sector_block : retry_sectors) {
+            if(this->is_cancelled()) {
+                throw std::runtime_error(this->token->get_reason());
+            }
+            for(unsigned int i : this->reflash_sector(job, journal, sector_block, std::min(blocks_per_sector, nr_blocks - sector_block))) {
+                this->failed_blocks.emplace_back(job.slot_id, i);
+            }
+        }
+        journal.flush();
+        if(nr_blocks > 0) {
+            advance(nr_blocks - 1);
+        }
+
+        // a completed job does not need to be resumed, and its slots are now known
+        if(std::none_of(this->failed_blocks.begin(), this->failed_blocks.end(),
+                        [&job](const auto& f){return f.first == job.slot_id;})) {
+            journal.remove();
+
+            SlotCache cache;
+            for(int offset=0; offset + (int)ChipDescriptor::SLOT_SIZE <= job.data.size(); offset += ChipDescriptor::SLOT_SIZE) {
+                cache.store(chip_id, job.data.mid(offset, ChipDescriptor::SLOT_SIZE));
+            }
+        }
+
+        page_offset += nr_blocks;
     }
 
     this->serial_interface->close_port();
 
     emit(flash_result_ready());
 }
+
+/**
+ * @brief Read back all blocks of a job that have not been verified while burning
+ * @param job flash job
+ * @param verified blocks (relative to the slot) that are already verified
+ * @param mismatched blocks (relative to the slot) that do not hold the data, extended
+ *        with the blocks that are read back and do not match
+ */
+void FlashThread::verify_unburned_blocks(const FlashJob& job, const std::set<unsigned int>& verified, std::set<unsigned int>& mismatched) {
+    const unsigned int nr_blocks = job.data.size() / ChipDescriptor::BLOCK_SIZE;
+    const unsigned int first_block = ChipDescriptor::get_slot_block(job.slot_id);
+
+    std::vector<unsigned int> block_ids;
+    std::vector<unsigned int> block_addrs;
+    for(unsigned int i=0; i<nr_blocks; i++) {
+        if(verified.count(i) == 0 && mismatched.count(i) == 0) {
+            block_ids.push_back(i);
+            block_addrs.push_back(first_block + i);
+        }
+    }
+    if(block_ids.empty()) {
+        return;
+    }
+
+    TRACE_DEBUG(trace_flash) << "Reading back " << block_ids.size() << " unburned blocks of slot " << job.slot_id << ".";
+    const QByteArray readback = this->serial_interface->read_block_list(block_addrs);
+    for(unsigned int k=0; k<block_ids.size(); k++) {
+        const unsigned int i = block_ids[k];
+        if(readback.mid(k * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE) !=
+           job.data.mid(i * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE)) {
+            TRACE_WARNING(trace_flash) << "Unburned block " << i << " of slot " << job.slot_id << " does not hold the data.";
+            mismatched.insert(i);
+        }
+    }
+}
+
+/**
+ * @brief Check that the chip reads back as erased after a chip erase
+ * @param chip descriptor of the chip
+ * @return whether all sampled blocks only hold 0xFF
+ *
+ * One block is sampled per sector, at a position that rotates over the
+ * blocks of the sector, such that a single batch read covers the chip.
+ */
+bool FlashThread::check_chip_erased(const ChipDescriptor* chip) {
+    const unsigned int blocks_per_sector = chip->get_blocks_per_sector();
+    std::vector<unsigned int> block_addrs;
+    for(unsigned int s=0; s<chip->get_nr_sectors(); s++) {
+        block_addrs.push_back(s * blocks_per_sector + s % blocks_per_sector);
+    }
+
+    const QByteArray readback = this->serial_interface->read_block_list(block_addrs);
+    return readback.size() == (int)(block_addrs.size() * ChipDescriptor::BLOCK_SIZE) &&
+           readback.count((char)0xFF) == readback.size();
+}
+
+/**
+ * @brief Erase a sector and burn all of its blocks again, retrying upon a mismatch
+ * @param job flash job
+ * @param journal journal of the slot
+ * @param sector_block first block of the sector (relative to the slot)
+ * @param nr_blocks number of blocks of the sector covered by the job
+ * @return blocks (relative to the slot) that could not be verified
+ *
+ * Blank blocks are burned as well, such that every block of the sector is
+ * read back. Blocks of the sector beyond the end of the job are left erased.
+ */
+std::vector<unsigned int> FlashThread::reflash_sector(const FlashJob& job, FlashJournal& journal, unsigned int sector_block, unsigned int nr_blocks) {
+    const unsigned int first_block = ChipDescriptor::get_slot_block(job.slot_id);
+    std::vector<unsigned int> failed;
+
+    for(unsigned int attempt=0; attempt<MAX_SECTOR_RETRIES; attempt++) {
+        failed.clear();
+        try {
+            TRACE_INFO(trace_flash) << "Erasing and programming sector at block " << first_block + sector_block << " again.";
+            this->serial_interface->erase_sector(first_block + sector_block);
+            journal.mark_erased(sector_block, nr_blocks);
+            for(unsigned int i=sector_block; i<sector_block + nr_blocks; i++) {
+                const QByteArray block = job.data.mid(i * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE);
+                const uint16_t crc = qChecksum(block.constData(), block.size());
+                const uint16_t crc_chip = this->serial_interface->burn_block_verify(first_block + i, block);
+                if(crc_chip == crc) {
+                    journal.mark_written(i);
+                } else {
+                    TRACE_WARNING(trace_flash) << "CRC mismatch on block " << i << ": " << crc_chip << " versus " << crc;
+                    failed.push_back(i);
+                }
+            }
+        }  catch (std::exception& e) {
+            TRACE_CRITICAL(trace_flash) << "Received error: " << e.what();
+            if(this->is_cancelled()) {
+                throw;
+            }
+            failed.clear();
+            for(unsigned int i=sector_block; i<sector_block + nr_blocks; i++) {
+                failed.push_back(i);
+            }
+        }
+
+        if(failed.empty()) {
+            break;
+        }
+    }
+
+    return failed;
+}
+
+/**
+ * @brief Check that the progress in the journal matches the cartridge
+ * @param job flash job
+ * @param journal journal of the slot
+ * @param verified set to the journaled blocks (relative to the slot) found on the cartridge
+ * @return whether all journaled blocks are found on the cartridge
+ */
+bool FlashThread::check_journal(const FlashJob& job, const FlashJournal& journal, std::set<unsigned int>& verified) {
+    const auto& written = journal.get_written_blocks();
+    if(written.empty()) {
+        return true;
+    }
+
+    // the cartridge may have been swapped or written elsewhere in the meantime, hence
+    // every journaled block is read back in a single batch before it is skipped
+    const unsigned int first_block = ChipDescriptor::get_slot_block(job.slot_id);
+    std::vector<unsigned int> block_addrs;
+    for(unsigned int block_id : written) {
+        if(block_id * ChipDescriptor::BLOCK_SIZE >= (unsigned int)job.data.size()) {
+            return false;
+        }
+        block_addrs.push_back(first_block + block_id);
+    }
+
+    const QByteArray readback = this->serial_interface->read_block_list(block_addrs);
+    unsigned int k = 0;
+    for(unsigned int block_id : written) {
+        if(readback.mid(k * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE) !=
+           job.data.mid(block_id * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE)) {
+            TRACE_WARNING(trace_flash) << "Journal of slot " << job.slot_id << " does not match cartridge, starting over.";
+            return false;
+        }
+        k++;
+    }
+
+    verified.insert(written.begin(), written.end());
+    return true;
+}
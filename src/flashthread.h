@@ -24,18 +24,40 @@
 #include <QMessageBox>
 #include <QIcon>
 
+#include <algorithm>
+#include <set>
+
 #include "ioworker.h"
+#include "flashplanner.h"
+#include "flashjournal.h"
+#include "chipdescriptor.h"
+
+/**
+ * @brief Single slot to be flashed as part of a (batch) flash job
+ */
+struct FlashJob {
+    int slot_id;            // ROM slot
+    QByteArray data;        // data to be flashed, padded to full blocks
+    QByteArray reference;   // known contents of the slot (if any)
+};
 
 /**
  * @brief class for Flashing a cartridge
  *
- * Currently, only support for the AT28C256 is implemented.
+ * A FlashThread flashes one or more slots in a single session: the port is
+ * opened and the chip id is checked only once for all jobs.
  */
 class FlashThread : public IOWorker {
 
     Q_OBJECT
 
 private:
+    static const unsigned int MAX_SECTOR_RETRIES = 2;   // attempts to reflash a sector that fails verification
+
+    bool differential = false;      // only erase and burn sectors that differ
+    bool resume = false;            // continue interrupted jobs from their journal
+    std::vector<FlashJob> jobs;     // slots to be flashed
+    std::vector<std::pair<int, unsigned int>> failed_blocks;   // (slot, block) that could not be verified
 
 public:
     /**
@@ -50,6 +72,62 @@ public:
     FlashThread(const std::shared_ptr<SerialInterface>& _serial_interface) :
         IOWorker(_serial_interface) {}
 
+    /**
+     * @brief Enable or disable differential flashing
+     * @param _differential whether only changed sectors are flashed
+     *
+     * In differential mode, the data is compared sector-by-sector to the
+     * current contents of the slot by the FlashPlanner. Unchanged sectors
+     * are skipped and sectors whose changed bits only go from 1 to 0 are
+     * programmed without an erase.
+     */
+    inline void set_differential(bool _differential) {
+        this->differential = _differential;
+    }
+
+    /**
+     * @brief Continue interrupted jobs for the same slot and image
+     * @param _resume whether to resume from the on-disk journal
+     *
+     * When resuming, sectors that were already erased are not erased again
+     * and blocks that were already written and verified are skipped. When
+     * not resuming, any existing journal of the slots is discarded.
+     */
+    inline void set_resume(bool _resume) {
+        this->resume = _resume;
+    }
+
+    /**
+     * @brief Add a slot to be flashed
+     * @param slot_id ROM slot
+     * @param data data to be flashed, padded to full blocks
+     * @param reference known contents of the slot, e.g. from a previous
+     *        write; when not provided in differential mode, the slot is
+     *        read from the cartridge prior to flashing
+     */
+    inline void add_job(int slot_id, const QByteArray& data, const QByteArray& reference = QByteArray()) {
+        this->jobs.push_back({slot_id, data, reference});
+    }
+
+    /**
+     * @brief Get the flash jobs (sorted by slot once the thread has started)
+     */
+    inline const auto& get_jobs() const {
+        return this->jobs;
+    }
+
+    /**
+     * @brief Get the total number of blocks of all jobs
+     */
+    unsigned int get_nr_blocks() const;
+
+    /**
+     * @brief Get the (slot, block) pairs that failed verification
+     */
+    inline const auto& get_failed_blocks() const {
+        return this->failed_blocks;
+    }
+
     /**
      * @brief run cart flash routine
      */
@@ -61,6 +139,41 @@ private:
      */
     void flash_sst39sf0x0();
 
+    /**
+     * @brief Read back all blocks of a job that have not been verified while burning
+     * @param job flash job
+     * @param verified blocks (relative to the slot) that are already verified
+     * @param mismatched blocks (relative to the slot) that do not hold the data, extended
+     *        with the blocks that are read back and do not match
+     */
+    void verify_unburned_blocks(const FlashJob& job, const std::set<unsigned int>& verified, std::set<unsigned int>& mismatched);
+
+    /**
+     * @brief Check that the chip reads back as erased after a chip erase
+     * @param chip descriptor of the chip
+     * @return whether all sampled blocks only hold 0xFF
+     */
+    bool check_chip_erased(const ChipDescriptor* chip);
+
+    /**
+     * @brief Erase a sector and burn all of its blocks again, retrying upon a mismatch
+     * @param job flash job
+     * @param journal journal of the slot
+     * @param sector_block first block of the sector (relative to the slot)
+     * @param nr_blocks number of blocks of the sector covered by the job
+     * @return blocks (relative to the slot) that could not be verified
+     */
+    std::vector<unsigned int> reflash_sector(const FlashJob& job, FlashJournal& journal, unsigned int sector_block, unsigned int nr_blocks);
+
+    /**
+     * @brief Check that the progress in the journal matches the cartridge
+     * @param job flash job
+     * @param journal journal of the slot
+     * @param verified set to the journaled blocks (relative to the slot) found on the cartridge
+     * @return whether all journaled blocks are found on the cartridge
+     */
+    bool check_journal(const FlashJob& job, const FlashJournal& journal, std::set<unsigned int>& verified);
+
 signals:
     /**
      * @brief signal when flash process is ready
@@ -68,16 +181,25 @@ signals:
     void flash_result_ready();
 
     /**
-     * @brief signal when new page is about to be written
-     * @param page_id
+     * @brief signal when flash process is aborted by an error; the job can be resumed
+     * @param error_msg description of the error
      */
-    void flash_block_start(unsigned int page_id);
+    void flash_interrupted(const QString& error_msg);
 
     /**
-     * @brief signal when new page is written
-     * @param page_id
+     * @brief signal when the flash plan is known, prior to any erase or burn
+     * @param nr_erases number of sector erases (all jobs)
+     * @param nr_burns number of block burns (all jobs)
+     * @param seconds predicted duration
+     */
+    void flash_plan_ready(unsigned int nr_erases, unsigned int nr_burns, double seconds);
+
+    /**
+     * @brief signal when flashing of a slot starts
+     * @param job_id index of the job
+     * @param slot_id ROM slot
      */
-    void flash_block_done(unsigned int page_id);
+    void flash_job_start(unsigned int job_id, unsigned int slot_id);
 
     /**
      * @brief signal when flash chip id is incorrect
@@ -0,0 +1,193 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "image_manifest.h"
+
+/**
+ * @brief Default constructor, creates an empty manifest
+ */
+ImageManifest::ImageManifest() {}
+
+/**
+ * @brief Build the manifest of an image
+ * @param data image
+ * @param image file name of the image
+ * @return manifest
+ */
+ImageManifest ImageManifest::from_image(const QByteArray& data, const QString& image) {
+    ImageManifest manifest;
+    manifest.image = image;
+    manifest.size = data.size();
+
+    // pad to whole slots with the erased state of the flash
+    QByteArray padded = data;
+    const unsigned int nr_slots = (data.size() + ChipDescriptor::SLOT_SIZE - 1) / ChipDescriptor::SLOT_SIZE;
+    padded.append(QByteArray(nr_slots * ChipDescriptor::SLOT_SIZE - data.size(), (char)0xFF));
+
+    manifest.slot_hashes = hash_chunks(padded, ChipDescriptor::SLOT_SIZE);
+    manifest.sector_hashes = hash_chunks(padded, SECTOR_SIZE);
+
+    return manifest;
+}
+
+/**
+ * @brief Load a manifest from file
+ * @param filename path to the manifest
+ * @return whether a valid manifest was loaded
+ */
+bool ImageManifest::load(const QString& filename) {
+    QFile infile(filename);
+    if(!infile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QJsonObject root = QJsonDocument::fromJson(infile.readAll()).object();
+    const QJsonArray slot_array = root["slots"].toArray();
+    const QJsonArray sector_array = root["sectors"].toArray();
+    if(slot_array.isEmpty()) {
+        qWarning() << filename << " does not hold any slot hashes.";
+        return false;
+    }
+
+    this->image = root["image"].toString();
+    this->size = root["size"].toInt();
+    this->slot_hashes.clear();
+    this->sector_hashes.clear();
+
+    for(int i=0; i<slot_array.size(); i++) {
+        this->slot_hashes.push_back(QByteArray::fromHex(slot_array[i].toObject()["sha256"].toString().toLatin1()));
+    }
+
+    // sector hashes are optional, a dump index only holds slot hashes
+    if(sector_array.size() == slot_array.size() * (int)(ChipDescriptor::SLOT_SIZE / SECTOR_SIZE)) {
+        for(int i=0; i<sector_array.size(); i++) {
+            this->sector_hashes.push_back(QByteArray::fromHex(sector_array[i].toObject()["sha256"].toString().toLatin1()));
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Store the manifest to file
+ * @param filename path to the manifest
+ * @return whether the manifest was written
+ */
+bool ImageManifest::save(const QString& filename) const {
+    QJsonArray slot_array;
+    for(unsigned int i=0; i<this->slot_hashes.size(); i++) {
+        QJsonObject slot;
+        slot["slot"] = (int)i;
+        slot["offset"] = (int)(i * ChipDescriptor::SLOT_SIZE);
+        slot["sha256"] = QString(this->slot_hashes[i].toHex());
+        slot_array.append(slot);
+    }
+
+    QJsonArray sector_array;
+    for(unsigned int i=0; i<this->sector_hashes.size(); i++) {
+        QJsonObject sector;
+        sector["sector"] = (int)i;
+        sector["offset"] = (int)(i * SECTOR_SIZE);
+        sector["sha256"] = QString(this->sector_hashes[i].toHex());
+        sector_array.append(sector);
+    }
+
+    QJsonObject manifest;
+    manifest["image"] = this->image;
+    manifest["size"] = (int)this->size;
+    manifest["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    manifest["slots"] = slot_array;
+    manifest["sectors"] = sector_array;
+
+    QFile outfile(filename);
+    if(!outfile.open(QIODevice::WriteOnly)) {
+        qCritical() << "Could not write manifest " << filename;
+        return false;
+    }
+    outfile.write(QJsonDocument(manifest).toJson());
+
+    return true;
+}
+
+/**
+ * @brief Whether the manifest was built from the given image
+ * @param data image
+ * @return whether the size and the slot hashes agree with the image
+ */
+bool ImageManifest::matches(const QByteArray& data) const {
+    if(this->size != (unsigned int)data.size()) {
+        return false;
+    }
+
+    QByteArray padded = data;
+    const unsigned int nr_slots = (data.size() + ChipDescriptor::SLOT_SIZE - 1) / ChipDescriptor::SLOT_SIZE;
+    padded.append(QByteArray(nr_slots * ChipDescriptor::SLOT_SIZE - data.size(), (char)0xFF));
+
+    return hash_chunks(padded, ChipDescriptor::SLOT_SIZE) == this->slot_hashes;
+}
+
+/**
+ * @brief Compare data read from a chip with the manifest
+ * @param data chip contents, starting at address zero
+ * @return slots that deviate from the manifest, empty when the chip passes
+ */
+std::vector<ImageManifest::Mismatch> ImageManifest::verify(const QByteArray& data) const {
+    const unsigned int sectors_per_slot = ChipDescriptor::SLOT_SIZE / SECTOR_SIZE;
+    std::vector<Mismatch> mismatches;
+
+    for(unsigned int i=0; i<this->slot_hashes.size(); i++) {
+        const QByteArray slot_data = data.mid(i * ChipDescriptor::SLOT_SIZE, ChipDescriptor::SLOT_SIZE);
+        if(slot_data.size() == (int)ChipDescriptor::SLOT_SIZE &&
+           QCryptographicHash::hash(slot_data, QCryptographicHash::Sha256) == this->slot_hashes[i]) {
+            continue;
+        }
+
+        Mismatch mismatch;
+        mismatch.slot = i;
+
+        // only hash the sectors of a deviating slot
+        for(unsigned int j=0; j<sectors_per_slot && !this->sector_hashes.empty(); j++) {
+            const unsigned int sector_id = i * sectors_per_slot + j;
+            const QByteArray sector_data = slot_data.mid(j * SECTOR_SIZE, SECTOR_SIZE);
+            if(sector_data.size() != (int)SECTOR_SIZE ||
+               QCryptographicHash::hash(sector_data, QCryptographicHash::Sha256) != this->sector_hashes[sector_id]) {
+                mismatch.sectors.push_back(sector_id);
+            }
+        }
+
+        mismatches.push_back(mismatch);
+    }
+
+    return mismatches;
+}
+
+/**
+ * @brief Hash consecutive chunks of data
+ * @param data data, padded with 0xFF to a whole number of chunks
+ * @param chunk_size size of a chunk
+ * @return hash per chunk
+ */
+std::vector<QByteArray> ImageManifest::hash_chunks(const QByteArray& data, unsigned int chunk_size) {
+    std::vector<QByteArray> hashes;
+    for(int offset=0; offset<data.size(); offset+=chunk_size) {
+        hashes.push_back(QCryptographicHash::hash(data.mid(offset, chunk_size), QCryptographicHash::Sha256));
+    }
+    return hashes;
+}
@@ -0,0 +1,149 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef IMAGE_MANIFEST_H
+#define IMAGE_MANIFEST_H
+
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+#include <vector>
+
+#include "chipdescriptor.h"
+
+/**
+ * @brief Expected SHA-256 hashes of every slot and sector of a ROM image
+ *
+ * The manifest is stored next to the image as "<image>.json", using the same
+ * layout as the index written by a serial dump, extended with the hashes of
+ * the 4 KB sectors. A chip read can then be checked against the manifest
+ * without comparing the data byte by byte. Images that do not fill their last
+ * slot are padded with 0xFF, the erased state of the flash.
+ */
+class ImageManifest {
+
+public:
+    static const unsigned int SECTOR_SIZE = 0x1000;
+
+    /**
+     * @brief Deviation of a single slot from the manifest
+     */
+    struct Mismatch {
+        unsigned int slot = 0;
+        std::vector<unsigned int> sectors;  // deviating sectors (chip-wide numbering)
+    };
+
+private:
+    QString image;                          // file name of the image
+    unsigned int size = 0;                  // size of the image in bytes
+    std::vector<QByteArray> slot_hashes;
+    std::vector<QByteArray> sector_hashes;  // empty for a dump index, which lacks sector hashes
+
+public:
+    /**
+     * @brief Default constructor, creates an empty manifest
+     */
+    ImageManifest();
+
+    /**
+     * @brief Build the manifest of an image
+     * @param data image
+     * @param image file name of the image
+     * @return manifest
+     */
+    static ImageManifest from_image(const QByteArray& data, const QString& image = QString());
+
+    /**
+     * @brief Get the file name of the manifest belonging to an image
+     * @param image_filename path to the image
+     * @return path to the manifest
+     */
+    static inline QString get_manifest_filename(const QString& image_filename) {
+        return image_filename + ".json";
+    }
+
+    /**
+     * @brief Load a manifest from file
+     * @param filename path to the manifest
+     * @return whether a valid manifest was loaded
+     */
+    bool load(const QString& filename);
+
+    /**
+     * @brief Store the manifest to file
+     * @param filename path to the manifest
+     * @return whether the manifest was written
+     */
+    bool save(const QString& filename) const;
+
+    /**
+     * @brief Whether the manifest holds any hashes
+     */
+    inline bool is_empty() const {
+        return this->slot_hashes.empty();
+    }
+
+    /**
+     * @brief Get the file name of the image
+     */
+    inline const QString& get_image() const {
+        return this->image;
+    }
+
+    /**
+     * @brief Number of slots covered by the manifest
+     */
+    inline unsigned int get_nr_slots() const {
+        return this->slot_hashes.size();
+    }
+
+    /**
+     * @brief Whether the manifest was built from the given image
+     * @param data image
+     * @return whether the size and the slot hashes agree with the image
+     */
+    bool matches(const QByteArray& data) const;
+
+    /**
+     * @brief Compare data read from a chip with the manifest
+     * @param data chip contents, starting at address zero
+     * @return slots that deviate from the manifest, empty when the chip passes
+     */
+    std::vector<Mismatch> verify(const QByteArray& data) const;
+
+private:
+    /**
+     * @brief Hash consecutive chunks of data
+     * @param data data, padded with 0xFF to a whole number of chunks
+     * @param chunk_size size of a chunk
+     * @return hash per chunk
+     */
+    static std::vector<QByteArray> hash_chunks(const QByteArray& data, unsigned int chunk_size);
+};
+
+#endif // IMAGE_MANIFEST_H
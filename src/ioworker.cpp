@@ -19,3 +19,43 @@
  ****************************************************************************/
 
 #include "ioworker.h"
+
+/**
+ * @brief Read the first blocks of a slot, served from the slot cache when its fingerprint matches
+ * @param chip_id chip id
+ * @param slot_id ROM slot
+ * @param nr_blocks number of blocks to read
+ * @param from_cache set to whether the data was served from the cache
+ * @param block_done optional callback invoked with the block id once a block has been received
+ * @return data of the blocks
+ *
+ * A cache hit only guarantees that the sampled blocks match, see SlotCache.
+ * The FlashThread reads back every block it skips after flashing, such that a
+ * differential flash against a stale cached image is still detected. A read
+ * lacks such a check, hence the ReadThread only uses the cache on request.
+ */
+QByteArray IOWorker::read_slot(unsigned int chip_id, unsigned int slot_id, unsigned int nr_blocks, bool& from_cache,
+                               const std::function<void(unsigned int)>& block_done) {
+    const unsigned int first_block = ChipDescriptor::get_slot_block(slot_id);
+
+    // establish the fingerprint of the slot from a few sampled blocks
+    std::vector<unsigned int> sample_addrs;
+    for(unsigned int block_id : SlotCache::get_sample_blocks()) {
+        sample_addrs.push_back(first_block + block_id);
+    }
+    const QByteArray fingerprint = SlotCache::get_fingerprint(chip_id, this->serial_interface->read_block_list(sample_addrs));
+
+    SlotCache cache;
+    const QByteArray image = this->use_slot_cache ? cache.lookup(fingerprint) : QByteArray();
+    if(!image.isEmpty()) {
+        qDebug() << "Serving slot " << slot_id << " from the slot cache.";
+        from_cache = true;
+        return image.left(nr_blocks * ChipDescriptor::BLOCK_SIZE);
+    }
+
+    from_cache = false;
+    QByteArray data = this->serial_interface->read_blocks(first_block, nr_blocks, block_done);
+    cache.store(chip_id, data);     // only complete slots are stored
+
+    return data;
+}
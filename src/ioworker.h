@@ -22,9 +22,12 @@
 #define IOWORKER_H
 
 #include <QThread>
+#include <atomic>
 #include <iostream>
 
 #include "serial_interface.h"
+#include "cancellationtoken.h"
+#include "slotcache.h"
 
 /**
  * @brief General worker thread that manages I/O with the cardreader
@@ -49,6 +52,17 @@ protected:
     // interface should be created in the MainWindow class
     std::shared_ptr<SerialInterface> serial_interface;
 
+    // cancellation of the operation, shared with the serial interface while running
+    std::shared_ptr<CancellationToken> token = std::make_shared<CancellationToken>();
+
+    // whether slots may be served from the slot cache on a fingerprint match; only
+    // safe when the data is verified afterwards, as for the reference of a flash
+    bool use_slot_cache = true;
+
+    // progress of the operation, sampled by the GUI rather than signalled per block
+    std::atomic<unsigned int> nr_blocks_done{0};
+    std::atomic<unsigned int> nr_blocks_total{0};
+
 public:
     IOWorker() {}
 
@@ -100,6 +114,60 @@ public:
         return this->data;
     }
 
+    /**
+     * @brief Enable or disable serving slots from the slot cache
+     * @param _use_slot_cache whether a fingerprint match is trusted
+     *
+     * When disabled, every slot is read in full; the cache is still
+     * refreshed with the data that is read.
+     */
+    inline void set_use_slot_cache(bool _use_slot_cache) {
+        this->use_slot_cache = _use_slot_cache;
+    }
+
+    /**
+     * @brief Request the operation to stop
+     *
+     * Commands in flight are completed and the worker stops before issuing
+     * the next command. This routine can be called from any thread.
+     */
+    inline void cancel() {
+        this->token->cancel();
+    }
+
+    /**
+     * @brief Set the deadline of the operation
+     * @param msecs time from now in ms, negative for no deadline
+     */
+    inline void set_deadline(qint64 msecs) {
+        this->token->set_deadline(msecs);
+    }
+
+    /**
+     * @brief Whether the operation has been cancelled or its deadline has expired
+     */
+    inline bool is_cancelled() const {
+        return this->token->is_cancelled();
+    }
+
+    /**
+     * @brief Get the number of blocks that have been processed
+     *
+     * This routine can be called from any thread.
+     */
+    inline unsigned int get_nr_blocks_done() const {
+        return this->nr_blocks_done.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the number of blocks of the operation, zero when not yet known
+     *
+     * This routine can be called from any thread.
+     */
+    inline unsigned int get_nr_blocks_total() const {
+        return this->nr_blocks_total.load(std::memory_order_relaxed);
+    }
+
     /**
      * @brief run routine
      *
@@ -113,7 +181,43 @@ public:
     virtual ~IOWorker() {}
 
 protected:
+    /**
+     * @brief Start counting the progress of the operation
+     * @param nr_blocks number of blocks of the operation
+     */
+    inline void set_progress_total(unsigned int nr_blocks) {
+        this->nr_blocks_done.store(0, std::memory_order_relaxed);
+        this->nr_blocks_total.store(nr_blocks, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Update the progress of the operation
+     * @param nr_blocks number of blocks that have been processed
+     */
+    inline void set_progress(unsigned int nr_blocks) {
+        this->nr_blocks_done.store(nr_blocks, std::memory_order_relaxed);
+    }
 
+    /**
+     * @brief Read the first blocks of a slot, served from the slot cache when its fingerprint matches
+     * @param chip_id chip id
+     * @param slot_id ROM slot
+     * @param nr_blocks number of blocks to read
+     * @param from_cache set to whether the data was served from the cache
+     * @param block_done optional callback invoked with the block id once a block has been received
+     * @return data of the blocks
+     */
+    QByteArray read_slot(unsigned int chip_id, unsigned int slot_id, unsigned int nr_blocks, bool& from_cache,
+                         const std::function<void(unsigned int)>& block_done = nullptr);
+
+    /**
+     * @brief Get a description of an error that aborted the operation
+     * @param e exception
+     * @return reason of the cancellation or the description of the exception
+     */
+    inline QString get_error_message(const std::exception& e) const {
+        return QString::fromStdString(this->is_cancelled() ? this->token->get_reason() : std::string(e.what()));
+    }
 };
 
 #endif // IOWORKER_H
@@ -387,8 +387,19 @@ void MainWindow::slot_load_machine_code() {
 
     QFile sourcefile(filename);
     if(sourcefile.open(QIODevice::ReadOnly)) {
-        this->hex_viewer->setData(new QHexView::DataStorageArray(sourcefile.readAll()));
+        const QByteArray data = sourcefile.readAll();
+        this->hex_viewer->setData(new QHexView::DataStorageArray(data));
         this->hex_viewer->viewport()->update();
+
+        // chips are verified against the manifest stored alongside the image, which
+        // is rebuilt when the image has been changed outside of the application
+        const QString manifest_filename = ImageManifest::get_manifest_filename(filename);
+        ImageManifest manifest;
+        if(!manifest.load(manifest_filename) || !manifest.matches(data)) {
+            qDebug() << "Rebuilding manifest: " << manifest_filename;
+            ImageManifest::from_image(data, QFileInfo(filename).fileName()).save(manifest_filename);
+        }
+        this->tl866_widget->set_manifest_file(manifest_filename);
     }
     qDebug() << "Load sourcecode from file: " << filename;
 }
@@ -408,7 +419,14 @@ void MainWindow::slot_save_machine_code() {
 
     QFile sourcefile(filename);
     if(sourcefile.open(QIODevice::WriteOnly)) {
-        sourcefile.write(this->hex_viewer->get_data());
+        const QByteArray data = this->hex_viewer->get_data();
+        sourcefile.write(data);
+
+        // store manifest of expected hashes alongside the image
+        const QString manifest_filename = ImageManifest::get_manifest_filename(filename);
+        if(ImageManifest::from_image(data, QFileInfo(filename).fileName()).save(manifest_filename)) {
+            this->tl866_widget->set_manifest_file(manifest_filename);
+        }
     }
     qDebug() << "Saved sourcecode to new file " << filename;
 }
@@ -797,12 +815,8 @@ void MainWindow::slot_tl866_assert_data() {
 void MainWindow::slot_tl866_parse_log() {
     auto log = this->tl866_widget->get_log_data();
 
-    // clean log
-    QString logstring(log);
-    logstring.remove("[K");
-
-    // send log to log object
-    this->log_viewer->setPlainText(logstring);
+    // send log to log object; redraw sequences have already been removed by the parser
+    this->log_viewer->setPlainText(QString(log));
 }
 
 /**
@@ -0,0 +1,83 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "progressmonitor.h"
+
+/**
+ * @brief Constructor
+ */
+ProgressMonitor::ProgressMonitor(QObject* parent) :
+    QObject(parent),
+    timer(this) {
+    this->timer.setInterval(SAMPLE_INTERVAL);
+    connect(&this->timer, SIGNAL(timeout()), this, SLOT(sample()));
+}
+
+/**
+ * @brief Start sampling a worker
+ * @param _worker worker, needs to outlive the monitor or stop() has to be called
+ */
+void ProgressMonitor::start(const IOWorker* _worker) {
+    this->worker = _worker;
+    this->last_nr_blocks = 0;
+    this->rate = 0.0;
+    this->clock.start();
+    this->timer.start();
+}
+
+/**
+ * @brief Stop sampling
+ */
+void ProgressMonitor::stop() {
+    this->timer.stop();
+    this->worker = nullptr;
+}
+
+/**
+ * @brief Sample the progress of the worker
+ */
+void ProgressMonitor::sample() {
+    if(this->worker == nullptr) {
+        return;
+    }
+
+    const unsigned int nr_blocks_total = this->worker->get_nr_blocks_total();
+    const unsigned int nr_blocks_done = this->worker->get_nr_blocks_done();
+    const double dt = (double)this->clock.restart() / 1000.0;
+
+    // blend the throughput of this interval into the average, weighted by its duration
+    if(dt > 0.0 && nr_blocks_done >= this->last_nr_blocks) {
+        const double current_rate = (double)(nr_blocks_done - this->last_nr_blocks) / dt;
+        if(this->rate <= 0.0) {
+            this->rate = current_rate;
+        } else {
+            const double alpha = 1.0 - std::exp(-dt * 1000.0 / (double)SMOOTHING_TIME);
+            this->rate += alpha * (current_rate - this->rate);
+        }
+    }
+    this->last_nr_blocks = nr_blocks_done;
+
+    double seconds_remaining = -1.0;
+    if(this->rate > 0.0 && nr_blocks_total >= nr_blocks_done) {
+        seconds_remaining = (double)(nr_blocks_total - nr_blocks_done) / this->rate;
+    }
+
+    emit(progress_updated(nr_blocks_done, nr_blocks_total, seconds_remaining));
+}
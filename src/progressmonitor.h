@@ -0,0 +1,97 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef PROGRESSMONITOR_H
+#define PROGRESSMONITOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include <cmath>
+
+#include "ioworker.h"
+
+/**
+ * @brief Samples the progress of an IO worker at a fixed rate
+ *
+ * The worker only updates an atomic block counter; the monitor polls this
+ * counter from the GUI thread such that the number of cross-thread events
+ * does not depend on the transfer speed. The throughput is smoothed by an
+ * exponentially weighted moving average to obtain a steady estimate of the
+ * remaining time.
+ */
+class ProgressMonitor : public QObject {
+
+    Q_OBJECT
+
+private:
+    const IOWorker* worker = nullptr;   // worker that is monitored
+    QTimer timer;                       // sample timer
+    QElapsedTimer clock;                // time since the previous sample
+
+    unsigned int last_nr_blocks = 0;    // blocks done at the previous sample
+    double rate = 0.0;                  // smoothed throughput in blocks per second
+
+    static const int SAMPLE_INTERVAL = 200;     // ms between samples
+    static const int SMOOTHING_TIME = 2000;     // ms, time constant of the moving average
+
+public:
+    /**
+     * @brief Constructor
+     */
+    ProgressMonitor(QObject* parent = nullptr);
+
+    /**
+     * @brief Start sampling a worker
+     * @param _worker worker, needs to outlive the monitor or stop() has to be called
+     */
+    void start(const IOWorker* _worker);
+
+    /**
+     * @brief Stop sampling
+     */
+    void stop();
+
+    /**
+     * @brief Get the smoothed throughput
+     * @return blocks per second
+     */
+    inline double get_rate() const {
+        return this->rate;
+    }
+
+signals:
+    /**
+     * @brief signal the sampled progress
+     * @param nr_blocks_done number of processed blocks
+     * @param nr_blocks_total number of blocks of the operation
+     * @param seconds_remaining estimated remaining time, negative when unknown
+     */
+    void progress_updated(unsigned int nr_blocks_done, unsigned int nr_blocks_total, double seconds_remaining);
+
+private slots:
+    /**
+     * @brief Sample the progress of the worker
+     */
+    void sample();
+};
+
+#endif // PROGRESSMONITOR_H
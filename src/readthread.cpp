@@ -27,19 +27,24 @@
  * class is runned
  */
 void ReadThread::run() {
-    unsigned int sector_counter = 0;
+    try {
+        this->serial_interface->set_cancellation_token(this->token);
+        this->serial_interface->open_port();
 
-    this->serial_interface->open_port();
+        // read the blocks of the slot, keeping several requests in flight, unless the
+        // same cartridge has been read before
+        this->set_progress_total(this->num_blocks);
+        const unsigned int chip_id = this->serial_interface->get_chip_id();
+        this->data = this->read_slot(chip_id, this->slot_id, this->num_blocks, this->from_cache, [this](unsigned int block_id) {
+            this->set_progress(block_id + 1);
+        });
+        this->set_progress(this->num_blocks);
 
-    // read the first 16 kb
-    for(unsigned int i=0; i<this->num_blocks; i++) {  // 64 blocks of 256 bytes each
-        emit(read_block_start(sector_counter));
-        auto sectordata = this->serial_interface->read_block(this->slot_id * 64 + i);
-        this->data.append(sectordata);
-        emit(read_block_done(sector_counter));
-        sector_counter++;
+        this->serial_interface->close_port();
+        emit(read_result_ready());
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        this->serial_interface->disconnect_port();
+        emit(read_error(this->get_error_message(e)));
     }
-
-    this->serial_interface->close_port();
-    emit(read_result_ready());
 }
@@ -33,13 +33,18 @@ class ReadThread : public IOWorker {
     Q_OBJECT
 
 private:
-    unsigned int num_blocks = 64;
+    unsigned int num_blocks = ChipDescriptor::get_blocks_per_slot();
+    bool from_cache = false;        // whether the data was served from the slot cache
 
 public:
-    ReadThread() {}
+    ReadThread() {
+        this->use_slot_cache = false;   // a cache hit is not verified against the cartridge
+    }
 
     ReadThread(const std::shared_ptr<SerialInterface>& _serial_interface) :
-        IOWorker(_serial_interface) {}
+        IOWorker(_serial_interface) {
+        this->use_slot_cache = false;   // a cache hit is not verified against the cartridge
+    }
 
     /**
      * @brief read the ROM from a cartridge
@@ -57,23 +62,24 @@ public:
         this->num_blocks = _num_blocks;
     }
 
-signals:
     /**
-     * @brief signal when rom has been read
+     * @brief Whether the data was served from the slot cache
      */
-    void read_result_ready();
+    inline bool is_from_cache() const {
+        return this->from_cache;
+    }
 
+signals:
     /**
-     * @brief signal when a new sector is about to be read
-     * @param sector_id
+     * @brief signal when rom has been read
      */
-    void read_block_start(unsigned int sector_id);
+    void read_result_ready();
 
     /**
-     * @brief signal when a new sector is read
-     * @param sector_id
+     * @brief signal when reading was aborted by an error or cancellation
+     * @param error_msg description of the error
      */
-    void read_block_done(unsigned int sector_id);
+    void read_error(const QString& error_msg);
 };
 
 #endif // READTHREAD_H
@@ -0,0 +1,286 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "serial_capture.h"
+
+/**
+ * @brief Constructor
+ * @param _device device to record, becomes a child of the capture device
+ * @param filename log file, new sessions are appended
+ */
+SerialCaptureDevice::SerialCaptureDevice(QIODevice* _device, const QString& filename, QObject* parent) :
+    QIODevice(parent),
+    device(_device),
+    logfile(filename) {
+    this->device->setParent(this);
+    connect(this->device, SIGNAL(readyRead()), this, SIGNAL(readyRead()));
+    connect(this->device, SIGNAL(bytesWritten(qint64)), this, SIGNAL(bytesWritten(qint64)));
+}
+
+/**
+ * @brief Open the log; the recorded device needs to be opened separately
+ */
+bool SerialCaptureDevice::open(OpenMode mode) {
+    if(!this->logfile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCritical() << "Could not open serial capture " << this->logfile.fileName();
+        return false;
+    }
+
+    this->stream.setDevice(&this->logfile);
+    if(this->logfile.size() == 0) {
+        this->stream.writeRawData(SerialCaptureLog::MAGIC, SerialCaptureLog::MAGIC_SIZE);
+    }
+    this->clock.start();
+    this->last_record = 0;
+
+    // reads are passed on to the recorded device directly
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+/**
+ * @brief Close both the log and the recorded device
+ */
+void SerialCaptureDevice::close() {
+    QIODevice::close();
+    this->device->close();
+    this->stream.setDevice(nullptr);
+    this->logfile.close();
+}
+
+qint64 SerialCaptureDevice::bytesAvailable() const {
+    return this->device->bytesAvailable() + QIODevice::bytesAvailable();
+}
+
+qint64 SerialCaptureDevice::bytesToWrite() const {
+    return this->device->bytesToWrite();
+}
+
+qint64 SerialCaptureDevice::readData(char* data, qint64 maxlen) {
+    qint64 nrbytes = this->device->read(data, maxlen);
+    if(nrbytes > 0) {
+        this->record(SerialCaptureLog::RECORD_READ, data, nrbytes);
+    }
+    return nrbytes;
+}
+
+qint64 SerialCaptureDevice::writeData(const char* data, qint64 len) {
+    qint64 nrbytes = this->device->write(data, len);
+    if(nrbytes > 0) {
+        this->record(SerialCaptureLog::RECORD_WRITE, data, nrbytes);
+    }
+    return nrbytes;
+}
+
+/**
+ * @brief Append a chunk of traffic to the log
+ */
+void SerialCaptureDevice::record(quint8 type, const char* data, qint64 len) {
+    if(!this->logfile.isOpen()) {
+        return;
+    }
+
+    for(qint64 offset=0; offset<len; offset+=SerialCaptureLog::MAX_RECORD_SIZE) {
+        const quint16 size = (quint16)std::min<qint64>(len - offset, SerialCaptureLog::MAX_RECORD_SIZE);
+
+        // store the time in whole microseconds without accumulating rounding errors
+        const qint64 delta = std::min<qint64>((this->clock.nsecsElapsed() - this->last_record) / 1000, 0xFFFFFFFF);
+        this->last_record += delta * 1000;
+
+        this->stream << type << (quint32)delta << size;
+        this->stream.writeRawData(data + offset, size);
+    }
+}
+
+/**
+ * @brief Constructor
+ * @param _filename log file
+ * @param _timed reproduce the timing of the recorded session
+ */
+SerialReplayDevice::SerialReplayDevice(const QString& _filename, bool _timed, QObject* parent) :
+    QIODevice(parent),
+    filename(_filename),
+    timed(_timed),
+    timer(this) {
+    this->timer.setSingleShot(true);
+    connect(&this->timer, SIGNAL(timeout()), this, SLOT(serve()));
+}
+
+/**
+ * @brief Load the log and start the replay
+ * @return whether the log could be loaded
+ */
+bool SerialReplayDevice::open(OpenMode mode) {
+    this->records.clear();
+    this->write_pos = 0;
+    this->write_offset = 0;
+    this->read_pos = 0;
+    this->buffer.clear();
+    this->nr_mismatches = 0;
+    this->write_mismatch = false;
+
+    if(!this->load()) {
+        return false;
+    }
+    this->skip_to_write();
+
+    this->clock.start();
+    if(!QIODevice::open(mode | QIODevice::Unbuffered)) {
+        return false;
+    }
+
+    // the board may have sent data before the first command
+    this->serve();
+    return true;
+}
+
+qint64 SerialReplayDevice::bytesAvailable() const {
+    return this->buffer.size() + QIODevice::bytesAvailable();
+}
+
+qint64 SerialReplayDevice::readData(char* data, qint64 maxlen) {
+    const int nrbytes = (int)std::min<qint64>(maxlen, this->buffer.size());
+    memcpy(data, this->buffer.constData(), nrbytes);
+    this->buffer.remove(0, nrbytes);
+    return nrbytes;
+}
+
+qint64 SerialReplayDevice::writeData(const char* data, qint64 len) {
+    const qint64 now = this->clock.nsecsElapsed() / 1000;
+
+    for(qint64 i=0; i<len; i++) {
+        if(this->write_pos >= this->records.size()) {
+            qWarning() << "Replay: " << len - i << " bytes written beyond the end of the recorded session.";
+            this->nr_mismatches += len - i;
+            break;
+        }
+
+        Record& record = this->records[this->write_pos];
+        if(record.data[this->write_offset] != data[i]) {
+            if(!this->write_mismatch) {
+                qWarning() << "Replay: written data deviates from record " << this->write_pos
+                           << " (" << record.data.toHex() << ")";
+            }
+            this->write_mismatch = true;
+            this->nr_mismatches++;
+        }
+
+        if(++this->write_offset == record.data.size()) {
+            record.replayed = now;
+            this->write_offset = 0;
+            this->write_mismatch = false;
+            this->write_pos++;
+            this->skip_to_write();
+        }
+    }
+
+    // a serial port reports written bytes from the event loop as well
+    QMetaObject::invokeMethod(this, "bytesWritten", Qt::QueuedConnection, Q_ARG(qint64, len));
+    this->serve();
+
+    return len;
+}
+
+/**
+ * @brief Load the records of the log
+ */
+bool SerialReplayDevice::load() {
+    QFile infile(this->filename);
+    if(!infile.open(QIODevice::ReadOnly)) {
+        qCritical() << "Could not open serial capture " << this->filename;
+        return false;
+    }
+
+    QDataStream stream(&infile);
+    char magic[SerialCaptureLog::MAGIC_SIZE];
+    if(stream.readRawData(magic, SerialCaptureLog::MAGIC_SIZE) != SerialCaptureLog::MAGIC_SIZE ||
+       memcmp(magic, SerialCaptureLog::MAGIC, SerialCaptureLog::MAGIC_SIZE) != 0) {
+        qCritical() << this->filename << " is not a serial capture.";
+        return false;
+    }
+
+    qint64 time = 0;
+    while(!stream.atEnd()) {
+        Record record;
+        quint32 delta = 0;
+        quint16 size = 0;
+        stream >> record.type >> delta >> size;
+        time += delta;
+        record.time = time;
+        record.data.resize(size);
+        if(stream.readRawData(record.data.data(), size) != size) {
+            qWarning() << "Serial capture " << this->filename << " is truncated.";
+            break;
+        }
+        this->records.push_back(record);
+    }
+
+    qDebug() << "Loaded " << this->records.size() << " records from " << this->filename;
+    return true;
+}
+
+/**
+ * @brief Position the write cursor at the next write record
+ */
+void SerialReplayDevice::skip_to_write() {
+    while(this->write_pos < this->records.size() && this->records[this->write_pos].type != SerialCaptureLog::RECORD_WRITE) {
+        this->write_pos++;
+    }
+}
+
+/**
+ * @brief Serve all received chunks that are due
+ *
+ * A received chunk is due once every record before it has been replayed
+ * and the recorded time between the chunk and its predecessor has passed.
+ */
+void SerialReplayDevice::serve() {
+    const qint64 now = this->clock.nsecsElapsed() / 1000;
+    bool received = false;
+
+    while(this->read_pos < this->records.size()) {
+        Record& record = this->records[this->read_pos];
+        if(record.type == SerialCaptureLog::RECORD_WRITE) {
+            if(record.replayed < 0) {
+                break;  // the host has not made this write yet
+            }
+            this->read_pos++;
+            continue;
+        }
+
+        qint64 due = now;
+        if(this->timed && this->read_pos > 0) {
+            const Record& previous = this->records[this->read_pos - 1];
+            due = previous.replayed + (record.time - previous.time);
+        }
+        if(due > now) {
+            this->timer.start((due - now + 999) / 1000);
+            break;
+        }
+
+        this->buffer.append(record.data);
+        record.replayed = this->timed ? due : now;
+        this->read_pos++;
+        received = true;
+    }
+
+    if(received) {
+        emit(readyRead());
+    }
+}
@@ -0,0 +1,201 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef SERIAL_CAPTURE_H
+#define SERIAL_CAPTURE_H
+
+#include <QIODevice>
+#include <QFile>
+#include <QDataStream>
+#include <QByteArray>
+#include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <vector>
+
+/**
+ * @brief Binary log of the traffic of a serial session
+ *
+ * The log starts with an 8-byte magic, followed by a record per chunk of
+ * data that was written to or read from the port:
+ *
+ *   quint8  type    'W' (written by the host) or 'R' (received from the board)
+ *   quint32 delta   time since the previous record in microseconds
+ *   quint16 length  number of data bytes
+ *   data
+ *
+ * All integers are big endian.
+ */
+namespace SerialCaptureLog {
+    static const char MAGIC[] = "GBCRCAP1";
+    static const int MAGIC_SIZE = 8;
+    static const quint8 RECORD_WRITE = 'W';
+    static const quint8 RECORD_READ = 'R';
+    static const int MAX_RECORD_SIZE = 0xFFFF;
+}
+
+/**
+ * @brief Device recording all traffic through another device to a log
+ *
+ * The capture device is placed between the SerialCommandEngine and the
+ * QSerialPort; it takes ownership of the port.
+ */
+class SerialCaptureDevice : public QIODevice {
+
+    Q_OBJECT
+
+private:
+    QIODevice* device;          // device that is recorded
+    QFile logfile;              // binary log
+    QDataStream stream;         // writes records to the log
+    QElapsedTimer clock;        // time since the log was opened
+    qint64 last_record = 0;     // time of the previous record (ns)
+
+public:
+    /**
+     * @brief Constructor
+     * @param _device device to record, becomes a child of the capture device
+     * @param filename log file, new sessions are appended
+     */
+    SerialCaptureDevice(QIODevice* _device, const QString& filename, QObject* parent = nullptr);
+
+    /**
+     * @brief Open the log; the recorded device needs to be opened separately
+     */
+    bool open(OpenMode mode) override;
+
+    /**
+     * @brief Close both the log and the recorded device
+     */
+    void close() override;
+
+    inline bool isSequential() const override {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override;
+
+    qint64 bytesToWrite() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxlen) override;
+
+    qint64 writeData(const char* data, qint64 len) override;
+
+private:
+    /**
+     * @brief Append a chunk of traffic to the log
+     */
+    void record(quint8 type, const char* data, qint64 len);
+};
+
+/**
+ * @brief Device serving a recorded session in place of a serial port
+ *
+ * Data written by the host is compared against the recorded writes. A
+ * received chunk is served once all writes that preceded it in the log
+ * have been made, after the same delay as in the recorded session, such
+ * that the timing of the board is reproduced. In fast mode, received
+ * chunks are served without delay.
+ */
+class SerialReplayDevice : public QIODevice {
+
+    Q_OBJECT
+
+private:
+    struct Record {
+        quint8 type;                // RECORD_WRITE or RECORD_READ
+        qint64 time;                // time in the recorded session (us)
+        QByteArray data;            // traffic
+        qint64 replayed = -1;       // time at which the record was replayed (us)
+    };
+
+    QString filename;               // log file
+    bool timed;                     // reproduce the timing of the recorded session
+    std::vector<Record> records;    // recorded traffic
+    size_t write_pos = 0;           // next write record
+    int write_offset = 0;           // number of bytes of the next write record that have been written
+    size_t read_pos = 0;            // next read record
+    QByteArray buffer;              // data that is available to the host
+    unsigned int nr_mismatches = 0; // number of written bytes that deviate from the log
+    bool write_mismatch = false;    // whether the current write record deviates from the log
+    QTimer timer;                   // serves delayed reads
+    QElapsedTimer clock;            // time since the start of the replay
+
+public:
+    /**
+     * @brief Constructor
+     * @param _filename log file
+     * @param _timed reproduce the timing of the recorded session
+     */
+    SerialReplayDevice(const QString& _filename, bool _timed = true, QObject* parent = nullptr);
+
+    /**
+     * @brief Load the log and start the replay
+     * @return whether the log could be loaded
+     */
+    bool open(OpenMode mode) override;
+
+    inline bool isSequential() const override {
+        return true;
+    }
+
+    qint64 bytesAvailable() const override;
+
+    /**
+     * @brief Get the number of written bytes that deviate from the log
+     */
+    inline unsigned int get_nr_mismatches() const {
+        return this->nr_mismatches;
+    }
+
+    /**
+     * @brief Whether all recorded traffic has been replayed
+     */
+    inline bool at_end() const {
+        return this->write_pos >= this->records.size() && this->read_pos >= this->records.size();
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxlen) override;
+
+    qint64 writeData(const char* data, qint64 len) override;
+
+private:
+    /**
+     * @brief Load the records of the log
+     */
+    bool load();
+
+    /**
+     * @brief Position the write cursor at the next write record
+     */
+    void skip_to_write();
+
+private slots:
+    /**
+     * @brief Serve all received chunks that are due
+     */
+    void serve();
+};
+
+#endif // SERIAL_CAPTURE_H
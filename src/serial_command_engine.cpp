@@ -0,0 +1,362 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "serial_command_engine.h"
+#include "trace.h"
+
+/**
+ * @brief Constructor
+ * @param _device serial device to communicate with
+ */
+SerialCommandEngine::SerialCommandEngine(QIODevice* _device) :
+    device(_device),
+    buffer(RECEIVE_BUFFER_SIZE),
+    deadline(this),
+    cancel_poll(this)
+{
+    this->deadline.setSingleShot(true);
+    this->cancel_poll.setInterval(CANCEL_POLL_INTERVAL);
+    this->clock.start();
+
+    connect(this->device, SIGNAL(readyRead()), this, SLOT(slot_ready_read()));
+    connect(this->device, SIGNAL(bytesWritten(qint64)), this, SLOT(slot_bytes_written(qint64)));
+    connect(&this->deadline, SIGNAL(timeout()), this, SLOT(slot_deadline_expired()));
+    connect(&this->cancel_poll, SIGNAL(timeout()), this, SLOT(slot_check_cancelled()));
+}
+
+/**
+ * @brief Queue a command for execution
+ * @param cmd command
+ */
+void SerialCommandEngine::submit(const SerialCommand& cmd) {
+    if(this->token && this->token->is_cancelled()) {
+        throw std::runtime_error(this->token->get_reason());
+    }
+    if(8 + cmd.nrbytes > (int)this->buffer.capacity()) {
+        throw std::runtime_error("Response of command " + cmd.command.toStdString() + " exceeds the receive buffer.");
+    }
+
+    this->queue.push_back(cmd);
+    this->dispatch();
+}
+
+/**
+ * @brief Run an event loop until all submitted commands are handled
+ */
+void SerialCommandEngine::wait_for_idle() {
+    if(!this->is_idle()) {
+        QEventLoop loop;
+        connect(this, SIGNAL(idle()), &loop, SLOT(quit()));
+        if(this->token) {
+            this->cancel_poll.start();
+        }
+        loop.exec();
+        this->cancel_poll.stop();
+    }
+
+    if(!this->last_error.empty()) {
+        std::string msg = this->last_error;
+        this->last_error.clear();
+        throw std::runtime_error(msg);
+    }
+}
+
+/**
+ * @brief Submit a single command and wait for its response
+ * @param cmd command
+ * @return response data (excluding echo)
+ */
+QByteArray SerialCommandEngine::execute(const SerialCommand& cmd) {
+    QByteArray response;
+    SerialCommand c = cmd;
+    c.on_complete = [&response, &cmd](const QByteArray& data) {
+        response = data;
+        if(cmd.on_complete) {
+            cmd.on_complete(data);
+        }
+    };
+
+    this->submit(c);
+    this->wait_for_idle();
+
+    return response;
+}
+
+/**
+ * @brief Process events for a period of time and discard any bytes
+ *        that were received but not requested
+ * @param timeout time (ms) to wait for stray bytes
+ * @return discarded bytes
+ */
+QByteArray SerialCommandEngine::drain(int timeout) {
+    QEventLoop loop;
+    QTimer::singleShot(timeout, &loop, SLOT(quit()));
+    loop.exec();
+
+    QByteArray discarded;
+    do {
+        discarded += this->buffer.to_byte_array();
+        this->buffer.clear();
+    } while(this->buffer.read_from(this->device) > 0);
+
+    return discarded;
+}
+
+/**
+ * @brief Write queued commands to the device as long as the window allows
+ */
+void SerialCommandEngine::dispatch() {
+    if(this->check_cancelled()) {
+        return;
+    }
+
+    while(!this->queue.empty() && !this->barrier && this->in_flight.size() < this->max_in_flight) {
+        // a command with payload may be queued behind outstanding commands as the board
+        // only reads its command once the previous ones are answered; its payload is
+        // released upon its echo, and no further commands are issued until then
+        PendingCommand pc;
+        pc.cmd = this->queue.front();
+        this->queue.pop_front();
+        pc.timing.command = pc.cmd.command;
+        pc.timing.issued = this->clock.nsecsElapsed();
+
+        TRACE_DEBUG(trace_engine) << "Send command: " << pc.cmd.command;
+        this->device->write(pc.cmd.command.constData(), 8);
+
+        this->barrier = !pc.cmd.payload.isEmpty();
+        this->in_flight.push_back(pc);
+        TRACE_EVENT(TraceEvent::COMMAND_SENT, pc.cmd.command.constData(), this->in_flight.size());
+
+        if(this->in_flight.size() == 1) {
+            this->restart_deadline();
+        }
+    }
+}
+
+/**
+ * @brief Parse received bytes and advance the state of outstanding commands
+ */
+void SerialCommandEngine::process() {
+    while(!this->in_flight.empty()) {
+        PendingCommand& pc = this->in_flight.front();
+
+        if(pc.state == State::AWAITING_ECHO) {
+            if(this->buffer.size() < 8) {
+                return;
+            }
+
+            // check in place that response is identical to command
+            if(!this->buffer.equals(0, pc.cmd.command.constData(), 8)) {
+                const QByteArray echo = this->buffer.view(0, 8).to_byte_array();
+                this->fail_all("Invalid response received (" + echo.toStdString() + ") from command " + pc.cmd.command.toStdString());
+                return;
+            }
+            this->buffer.discard(8);
+            TRACE_DEBUG(trace_engine) << "Response succesfully received: " << pc.cmd.command;
+            TRACE_EVENT(TraceEvent::ECHO_RECEIVED, pc.cmd.command.constData(), 0);
+
+            pc.timing.echoed = this->clock.nsecsElapsed();
+            pc.state = State::AWAITING_RESPONSE;
+            this->restart_deadline();
+
+            // release the payload now that the board is listening for it; subsequent
+            // commands can be queued behind it
+            if(!pc.cmd.payload.isEmpty()) {
+                this->device->write(pc.cmd.payload);
+                TRACE_EVENT(TraceEvent::PAYLOAD_SENT, pc.cmd.command.constData(), pc.cmd.payload.size());
+                this->barrier = false;
+                this->dispatch();
+            }
+        }
+
+        if(pc.state == State::AWAITING_RESPONSE) {
+            if(this->buffer.size() < (size_t)pc.cmd.nrbytes) {
+                return;
+            }
+
+            SerialCommand cmd = std::move(pc.cmd);
+            SerialCommandTiming timing = pc.timing;
+            this->in_flight.pop_front();
+            TRACE_EVENT(TraceEvent::RESPONSE_RECEIVED, cmd.command.constData(), cmd.nrbytes);
+
+            if(this->timing_sink) {
+                timing.completed = this->clock.nsecsElapsed();
+                timing.nrbytes = cmd.payload.size() + cmd.nrbytes;
+                this->timing_sink(timing);
+            }
+
+            // start the clock for the next outstanding command and top up the window
+            if(!this->in_flight.empty()) {
+                this->restart_deadline();
+            } else {
+                this->deadline.stop();
+            }
+            this->dispatch();
+
+            // the response is consumed once the callbacks are done with it
+            const SerialResponseView response = this->buffer.view(0, cmd.nrbytes);
+            if(cmd.on_view) {
+                cmd.on_view(response);
+            }
+            if(cmd.on_complete) {
+                cmd.on_complete(response.to_byte_array());
+            }
+            this->buffer.discard(cmd.nrbytes);
+        }
+    }
+
+    if(this->in_flight.empty() && this->buffer.size() > 0) {
+        TRACE_DEBUG(trace_engine) << "Discarding unrequested bytes: " << this->buffer.to_byte_array();
+        this->buffer.clear();
+    }
+
+    if(this->is_idle()) {
+        emit(idle());
+    }
+}
+
+/**
+ * @brief Discard the queued commands when the operation is cancelled
+ * @return whether the operation is cancelled
+ */
+bool SerialCommandEngine::check_cancelled() {
+    if(!this->token || !this->token->is_cancelled()) {
+        return false;
+    }
+
+    if(!this->queue.empty()) {
+        const std::string msg = this->token->get_reason();
+        TRACE_WARNING(trace_engine) << msg.c_str() << ", discarding " << this->queue.size() << " queued commands.";
+        if(this->last_error.empty()) {
+            this->last_error = msg;
+        }
+
+        // the commands in flight are completed such that the board finishes its current operation
+        std::deque<SerialCommand> discarded;
+        discarded.swap(this->queue);
+        for(const auto& cmd : discarded) {
+            if(cmd.on_error) {
+                cmd.on_error(msg);
+            }
+        }
+
+        if(this->in_flight.empty()) {
+            emit(idle());
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Fail all queued and outstanding commands
+ * @param msg error message
+ */
+void SerialCommandEngine::fail_all(const std::string& msg) {
+    TRACE_EVENT(TraceEvent::COMMAND_FAILED, this->in_flight.empty() ? nullptr : this->in_flight.front().cmd.command.constData(), this->buffer.size());
+    TRACE_CRITICAL(trace_engine) << msg.c_str();
+    TRACE_DUMP();
+    if(this->last_error.empty()) {
+        this->last_error = msg;
+    }
+
+    std::deque<SerialCommand> failed;
+    for(const auto& pc : this->in_flight) {
+        failed.push_back(pc.cmd);
+    }
+    failed.insert(failed.end(), this->queue.begin(), this->queue.end());
+
+    this->in_flight.clear();
+    this->queue.clear();
+    this->buffer.clear();
+    this->barrier = false;
+    this->deadline.stop();
+
+    for(const auto& cmd : failed) {
+        if(cmd.on_error) {
+            cmd.on_error(msg);
+        }
+    }
+
+    emit(idle());
+}
+
+/**
+ * @brief (Re)start the deadline for the oldest outstanding command
+ */
+void SerialCommandEngine::restart_deadline() {
+    this->deadline.start(this->in_flight.front().cmd.timeout);
+}
+
+/**
+ * @brief Slot accepting new data on the device
+ */
+void SerialCommandEngine::slot_ready_read() {
+    // read straight into the receive buffer; when it fills up, consume responses to make room
+    qint64 nrbytes = 0;
+    while((nrbytes = this->buffer.read_from(this->device)) > 0) {
+        TRACE_EVENT(TraceEvent::BYTES_RECEIVED, nullptr, nrbytes);
+        if(!this->buffer.is_full()) {
+            break;
+        }
+        this->process();
+        if(this->buffer.is_full()) {
+            this->fail_all("Receive buffer overflow.");
+            return;
+        }
+    }
+
+    if(!this->in_flight.empty()) {
+        this->restart_deadline();
+    }
+    this->process();
+}
+
+/**
+ * @brief Slot accepting that data has been written to the device
+ */
+void SerialCommandEngine::slot_bytes_written(qint64 nrbytes) {
+    Q_UNUSED(nrbytes);
+
+    // writing is progress as well; do not let a long payload expire the deadline
+    if(!this->in_flight.empty()) {
+        this->restart_deadline();
+    }
+}
+
+/**
+ * @brief Slot accepting an expired deadline
+ */
+void SerialCommandEngine::slot_deadline_expired() {
+    if(this->in_flight.empty()) {
+        return;
+    }
+
+    TRACE_DEBUG(trace_engine) << "Failed to capture response, outputting buffer:";
+    TRACE_DEBUG(trace_engine) << this->buffer.to_byte_array();
+    this->fail_all("Timeout waiting for response to command " + this->in_flight.front().cmd.command.toStdString() + ", terminating.");
+}
+
+/**
+ * @brief Slot periodically checking for cancellation while waiting
+ */
+void SerialCommandEngine::slot_check_cancelled() {
+    this->check_cancelled();
+}
@@ -0,0 +1,255 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef SERIAL_COMMAND_ENGINE_H
+#define SERIAL_COMMAND_ENGINE_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QByteArray>
+#include <QTimer>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <string>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <memory>
+
+#include "cancellationtoken.h"
+#include "serial_ring_buffer.h"
+
+/**
+ * @brief Single command sent to the cartridge reader
+ *
+ * Every command consists of an 8-byte command string which is echoed by the
+ * board. Optionally, a payload is sent once the echo has been received (e.g.
+ * the 256 data bytes of WRBK) after which the board answers with nrbytes of
+ * response data.
+ */
+struct SerialCommand {
+    QByteArray command;                                     // 8-byte command string
+    QByteArray payload;                                     // data sent after the echo is received
+    int nrbytes = 0;                                        // number of response bytes after the echo
+    int timeout = 3000;                                     // deadline (ms) for the board to make progress
+    std::function<void(const SerialResponseView&)> on_view; // called with a view of the response data
+    std::function<void(const QByteArray&)> on_complete;     // called with a copy of the response data
+    std::function<void(const std::string&)> on_error;       // called when the command fails
+};
+
+/**
+ * @brief Timing of a single command, used for benchmarking
+ *
+ * All timestamps are in nanoseconds relative to the creation of the engine.
+ */
+struct SerialCommandTiming {
+    QByteArray command;         // 8-byte command string
+    qint64 issued = 0;          // command written to the device
+    qint64 echoed = 0;          // echo received and validated
+    qint64 completed = 0;       // response received
+    int nrbytes = 0;            // payload and response bytes transferred after the echo
+};
+
+/**
+ * @brief Event-driven engine executing commands on a serial device
+ *
+ * Commands are written to the device and their responses are parsed from
+ * the readyRead signal of the device by a small per-command state machine.
+ * Up to max_in_flight commands (without payload) can be outstanding at the
+ * same time; the board answers them in order. A command carrying a payload
+ * acts as a barrier: it can be queued behind outstanding commands, but its
+ * payload can only be sent once its echo has been received and no further
+ * commands are issued before that.
+ *
+ * Received bytes are read into a preallocated ring buffer in which echoes
+ * are validated in place. Responses are handed to on_view as a view into
+ * this buffer, which avoids any allocation; on_complete receives a copy.
+ * Completion callbacks must not run an event loop.
+ *
+ * The engine does not own the device; it lives in the thread of the device
+ * and requires an event loop in that thread. The blocking routines execute()
+ * and wait_for_idle() provide such an event loop for synchronous callers.
+ * When the device is moved to another thread, the engine has to be moved
+ * along with it.
+ *
+ * When a cancellation token is set, queued commands are discarded once the
+ * token is cancelled; commands in flight are still completed.
+ */
+class SerialCommandEngine : public QObject {
+
+    Q_OBJECT
+
+public:
+    enum class State {
+        AWAITING_ECHO,
+        AWAITING_RESPONSE,
+    };
+
+private:
+    struct PendingCommand {
+        SerialCommand cmd;
+        State state = State::AWAITING_ECHO;
+        SerialCommandTiming timing;
+    };
+
+    QIODevice* device;                          // device to communicate with (not owned)
+    std::deque<SerialCommand> queue;            // commands that still need to be written
+    std::deque<PendingCommand> in_flight;       // commands written, awaiting their response
+    SerialRingBuffer buffer;                    // received bytes not yet consumed
+    QTimer deadline;                            // fires when the board stops making progress
+    unsigned int max_in_flight = 1;             // maximum number of outstanding commands
+    bool barrier = false;                       // payload of a command still needs to be sent
+    std::string last_error;                     // first error since the last call to wait_for_idle
+    QElapsedTimer clock;                        // reference clock for command timings
+    std::function<void(const SerialCommandTiming&)> timing_sink;    // receives timing of completed commands
+    std::shared_ptr<CancellationToken> token;   // cancellation of the current operation
+    QTimer cancel_poll;                         // checks the token while waiting
+    static const int CANCEL_POLL_INTERVAL = 50; // interval (ms) of checking the token
+    static const int RECEIVE_BUFFER_SIZE = 0x4000;  // capacity of the receive buffer
+
+public:
+    /**
+     * @brief Constructor
+     * @param _device serial device to communicate with
+     */
+    SerialCommandEngine(QIODevice* _device);
+
+    /**
+     * @brief Set the maximum number of outstanding commands
+     * @param _max_in_flight number of commands (at least 1)
+     */
+    inline void set_max_in_flight(unsigned int _max_in_flight) {
+        this->max_in_flight = std::max(1u, _max_in_flight);
+    }
+
+    /**
+     * @brief Set a callback receiving the timing of every completed command
+     * @param _timing_sink callback, nullptr to disable
+     */
+    inline void set_timing_sink(const std::function<void(const SerialCommandTiming&)>& _timing_sink) {
+        this->timing_sink = _timing_sink;
+    }
+
+    /**
+     * @brief Set the token used to cancel the current operation
+     * @param _token token, nullptr to disable
+     */
+    inline void set_cancellation_token(const std::shared_ptr<CancellationToken>& _token) {
+        this->token = _token;
+    }
+
+    /**
+     * @brief Whether no commands are queued or outstanding
+     */
+    inline bool is_idle() const {
+        return this->queue.empty() && this->in_flight.empty();
+    }
+
+    /**
+     * @brief Queue a command for execution
+     * @param cmd command
+     *
+     * The completion callbacks of the command are invoked from the event
+     * loop of the thread in which this object lives. Throws when the
+     * operation has been cancelled.
+     */
+    void submit(const SerialCommand& cmd);
+
+    /**
+     * @brief Run an event loop until all submitted commands are handled
+     *
+     * Throws a std::runtime_error when any of the commands has failed.
+     */
+    void wait_for_idle();
+
+    /**
+     * @brief Submit a single command and wait for its response
+     * @param cmd command
+     * @return response data (excluding echo)
+     */
+    QByteArray execute(const SerialCommand& cmd);
+
+    /**
+     * @brief Process events for a period of time and discard any bytes
+     *        that were received but not requested
+     * @param timeout time (ms) to wait for stray bytes
+     * @return discarded bytes
+     */
+    QByteArray drain(int timeout);
+
+private:
+    /**
+     * @brief Write queued commands to the device as long as the window allows
+     */
+    void dispatch();
+
+    /**
+     * @brief Parse received bytes and advance the state of outstanding commands
+     */
+    void process();
+
+    /**
+     * @brief Discard the queued commands when the operation is cancelled
+     * @return whether the operation is cancelled
+     */
+    bool check_cancelled();
+
+    /**
+     * @brief Fail all queued and outstanding commands
+     * @param msg error message
+     */
+    void fail_all(const std::string& msg);
+
+    /**
+     * @brief (Re)start the deadline for the oldest outstanding command
+     */
+    void restart_deadline();
+
+signals:
+    /**
+     * @brief signal when all commands have been handled
+     */
+    void idle();
+
+private slots:
+    /**
+     * @brief Slot accepting new data on the device
+     */
+    void slot_ready_read();
+
+    /**
+     * @brief Slot accepting that data has been written to the device
+     */
+    void slot_bytes_written(qint64 nrbytes);
+
+    /**
+     * @brief Slot accepting an expired deadline
+     */
+    void slot_deadline_expired();
+
+    /**
+     * @brief Slot periodically checking for cancellation while waiting
+     */
+    void slot_check_cancelled();
+};
+
+#endif // SERIAL_COMMAND_ENGINE_H
@@ -19,6 +19,7 @@
  ****************************************************************************/
 
 #include "serial_interface.h"
+#include "trace.h"
 
 /**
  * @brief SerialInterface
@@ -29,23 +30,73 @@ SerialInterface::SerialInterface(const std::string& _portname, int _baudrate) {
     this->baudrate = _baudrate;
 }
 
+/**
+ * @brief Set a callback receiving the timing of every completed command
+ * @param _timing_sink callback, nullptr to disable
+ */
+void SerialInterface::set_timing_sink(const std::function<void(const SerialCommandTiming&)>& _timing_sink) {
+    this->timing_sink = _timing_sink;
+    if(this->engine) {
+        this->engine->set_timing_sink(this->timing_sink);
+    }
+}
+
+/**
+ * @brief Set the token used to cancel the current operation
+ * @param _token token, nullptr to disable
+ */
+void SerialInterface::set_cancellation_token(const std::shared_ptr<CancellationToken>& _token) {
+    this->token = _token;
+    if(this->engine) {
+        this->engine->set_cancellation_token(this->token);
+    }
+}
+
 /**
  * @brief Create a new QSerialPort object and specify
  *        communication settings
  */
 void SerialInterface::open_port() {
-    if(this->portname.size() == 0) {
-        throw std::exception("No port has been set");
+    if(this->portname.size() == 0 && this->replay_file.empty()) {
+        throw std::runtime_error("No port has been set");
     }
 
-    this->port = std::make_unique<QSerialPort>(this->portname.c_str());
-    this->port->setBaudRate(this->baudrate);
-    this->port->setDataBits(QSerialPort::Data8);
-    this->port->setStopBits(QSerialPort::OneStop);
-    this->port->setParity(QSerialPort::NoParity);
-    this->port->setFlowControl(QSerialPort::NoFlowControl);
+    // reuse the session when the port is still in working order
+    if(this->is_open() && (this->serial_port == nullptr || this->serial_port->error() == QSerialPort::NoError)) {
+        return;
+    }
+    this->disconnect_port();
+
+    if(!this->replay_file.empty()) {
+        auto replay = std::make_unique<SerialReplayDevice>(QString::fromStdString(this->replay_file), this->replay_timed);
+        if(!replay->open(QIODevice::ReadWrite)) {
+            throw std::runtime_error("Could not load recorded session " + this->replay_file);
+        }
+        this->port = std::move(replay);
+    } else {
+        auto serial = std::make_unique<QSerialPort>(this->portname.c_str());
+        serial->setBaudRate(this->baudrate);
+        serial->setDataBits(QSerialPort::Data8);
+        serial->setStopBits(QSerialPort::OneStop);
+        serial->setParity(QSerialPort::NoParity);
+        serial->setFlowControl(QSerialPort::NoFlowControl);
+
+        serial->open(QIODevice::ReadWrite);
+        this->serial_port = serial.get();
+
+        // the capture device takes ownership of the port
+        if(!this->capture_file.empty()) {
+            auto capture = std::make_unique<SerialCaptureDevice>(serial.release(), QString::fromStdString(this->capture_file));
+            capture->open(QIODevice::ReadWrite);
+            this->port = std::move(capture);
+        } else {
+            this->port = std::move(serial);
+        }
+    }
 
-    this->port->open(QIODevice::ReadWrite);
+    this->engine = std::make_unique<SerialCommandEngine>(this->port.get());
+    this->engine->set_timing_sink(this->timing_sink);
+    this->engine->set_cancellation_token(this->token);
 }
 
 /**
@@ -53,8 +104,77 @@ void SerialInterface::open_port() {
  *        the QSerialPort object
  */
 void SerialInterface::close_port() {
-    this->port->close();
-    this->port.reset();
+    this->set_cancellation_token(nullptr);
+
+    if(this->persistent && this->is_open() && (this->serial_port == nullptr || this->serial_port->error() == QSerialPort::NoError)) {
+        this->move_to_thread(QCoreApplication::instance()->thread());
+        return;
+    }
+
+    this->disconnect_port();
+}
+
+/**
+ * @brief Close the communication port regardless of persistence
+ */
+void SerialInterface::disconnect_port() {
+    this->token.reset();
+    this->engine.reset();
+    if(this->port) {
+        this->port->close();
+        this->port.reset();
+    }
+    this->serial_port = nullptr;
+
+    // another board or chip may be found upon reconnecting
+    this->board_info.clear();
+    this->chip_id = 0;
+    this->eeprom_access = EepromAccess::UNKNOWN;
+    this->eeprom_cache.clear();
+}
+
+/**
+ * @brief Hand the open port to the thread that performs the next operation
+ * @param thread worker thread
+ */
+void SerialInterface::move_to_thread(QThread* thread) {
+    if(!this->port) {
+        return;
+    }
+
+    // a port left behind by an aborted operation cannot be moved anymore
+    if(this->port->thread() != QThread::currentThread()) {
+        TRACE_WARNING(trace_serial) << "Discarding session on " << this->portname.c_str() << " left behind by an aborted operation.";
+        this->disconnect_port();
+        return;
+    }
+
+    this->port->moveToThread(thread);
+    this->engine->moveToThread(thread);
+}
+
+/**
+ * @brief Check that the board still responds and refresh the chip id
+ * @return whether the session is alive
+ */
+bool SerialInterface::keepalive() {
+    try {
+        bool reconnect = !this->is_open();
+        this->open_port();
+        if(reconnect) {
+            TRACE_INFO(trace_serial) << "Reconnected to " << this->portname.c_str();
+            this->get_board_info();
+        }
+
+        // the cartridge may have been swapped in the meantime
+        this->chip_id = 0;
+        this->get_chip_id();
+        return true;
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        this->disconnect_port();
+        return false;
+    }
 }
 
 /********************************************************
@@ -66,6 +186,10 @@ void SerialInterface::close_port() {
  * @return identifier string
  */
 std::string SerialInterface::get_board_info() {
+    if(!this->board_info.empty()) {
+        return this->board_info;
+    }
+
     try {
         char command[] = "READINFO";
         QByteArray response_data = this->send_command_capture_response(command, 16);
@@ -79,7 +203,8 @@ std::string SerialInterface::get_board_info() {
             throw std::runtime_error("Unidentified chipset");
         }
 
-        return response_data.toStdString();
+        this->board_info = response_data.toStdString();
+        return this->board_info;
     }  catch (std::exception& e) {
         std::cerr << "Caught error: " << e.what() << std::endl;
         throw e;
@@ -103,6 +228,94 @@ QByteArray SerialInterface::read_block(unsigned int sector_addr) {
     }
 }
 
+/**
+ * @brief Read a contiguous range of blocks (0x100 bytes each) from cartridge
+ * @param block_addr address of the first block
+ * @param nr_blocks number of blocks to read
+ * @param block_done optional callback invoked with the (relative) block id
+ *        once a block has been received
+ * @return data of all blocks
+ */
+QByteArray SerialInterface::read_blocks(unsigned int block_addr, unsigned int nr_blocks,
+                                        const std::function<void(unsigned int)>& block_done) {
+    // every block is written straight to its final position
+    QByteArray data(nr_blocks * 0x100, Qt::Uninitialized);
+    char* dest = data.data();
+
+    this->stream_blocks(block_addr, nr_blocks, [dest, &block_done](unsigned int block_id, const SerialResponseView& block) {
+        block.copy_to(dest + block_id * 0x100);
+        if(block_done) {
+            block_done(block_id);
+        }
+    });
+
+    return data;
+}
+
+/**
+ * @brief Stream a contiguous range of blocks (0x100 bytes each) from cartridge
+ * @param block_addr address of the first block
+ * @param nr_blocks number of blocks to read
+ * @param sink callback invoked with the (relative) block id and block data
+ */
+void SerialInterface::stream_blocks(unsigned int block_addr, unsigned int nr_blocks,
+                                    const std::function<void(unsigned int, const SerialResponseView&)>& sink) {
+    std::vector<unsigned int> block_addrs(nr_blocks);
+    for(unsigned int i=0; i<nr_blocks; i++) {
+        block_addrs[i] = block_addr + i;
+    }
+
+    this->stream_block_list(block_addrs, sink);
+}
+
+/**
+ * @brief Read an arbitrary set of blocks (0x100 bytes each) from cartridge
+ * @param block_addrs addresses of the blocks
+ * @return data of all blocks, in the order of the addresses
+ */
+QByteArray SerialInterface::read_block_list(const std::vector<unsigned int>& block_addrs) {
+    QByteArray data(block_addrs.size() * 0x100, Qt::Uninitialized);
+    char* dest = data.data();
+
+    this->stream_block_list(block_addrs, [dest](unsigned int i, const SerialResponseView& block) {
+        block.copy_to(dest + i * 0x100);
+    });
+
+    return data;
+}
+
+/**
+ * @brief Stream an arbitrary set of blocks (0x100 bytes each) from cartridge
+ * @param block_addrs addresses of the blocks
+ * @param sink callback invoked with the index of the block in the list and block data
+ */
+void SerialInterface::stream_block_list(const std::vector<unsigned int>& block_addrs,
+                                        const std::function<void(unsigned int, const SerialResponseView&)>& sink) {
+    try {
+        // queue all block requests, the engine keeps read_window of them in flight
+        this->engine->set_max_in_flight(this->read_window);
+        for(unsigned int i=0; i<block_addrs.size(); i++) {
+            SerialCommand cmd;
+            cmd.command = QByteArray::fromStdString((boost::format("RDBK%04X") % block_addrs[i]).str());
+            cmd.nrbytes = 0x100;
+            cmd.timeout = SERIAL_TIMEOUT_BLOCK;
+            cmd.on_view = [&sink, i](const SerialResponseView& response) {
+                sink(i, response);
+            };
+            this->engine->submit(cmd);
+        }
+        this->engine->wait_for_idle();
+        this->engine->set_max_in_flight(1);
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        this->engine->set_max_in_flight(1);
+
+        // discard responses of any requests that were still in flight
+        this->flush_buffer();
+        throw e;
+    }
+}
+
 /**
  * @brief Erase sector (4096 bytes) on SST39SF0x0 chip
  * @param start address
@@ -113,13 +326,32 @@ void SerialInterface::erase_sector(unsigned int sector_id) {
         auto response = this->send_command_capture_response(command, 2);
         uint16_t nrcycles = 0;
         memcpy((void*)&nrcycles, (void*)&response.data()[0], 2);
-        qDebug() << "Succesfully erased sector " << sector_id << " in " << nrcycles << " cyles.";
+        TRACE_DEBUG(trace_serial) << "Succesfully erased sector " << sector_id << " in " << nrcycles << " cyles.";
     }  catch (std::exception& e) {
         std::cerr << "Caught error: " << e.what() << std::endl;
         throw e;
     }
 }
 
+/**
+ * @brief Erase the complete SST39SF0x0 chip
+ * @param erase_time maximum duration of the chip erase in ms
+ */
+void SerialInterface::erase_chip(unsigned int erase_time) {
+    static const std::vector<std::pair<uint16_t, uint8_t>> sequence = {
+        {0x5555, 0xAA}, {0x2AAA, 0x55}, {0x5555, 0x80},
+        {0x5555, 0xAA}, {0x2AAA, 0x55}, {0x5555, 0x10},
+    };
+
+    for(const auto& cycle : sequence) {
+        this->write_address(cycle.first, cycle.second);
+    }
+
+    // the board does not report completion of the erase
+    QThread::msleep(erase_time);
+    TRACE_DEBUG(trace_serial) << "Succesfully erased chip.";
+}
+
 /**
  * @brief Burn block (256 bytes) to SST39SF0x0 chip
  * @param start address
@@ -127,7 +359,7 @@ void SerialInterface::erase_sector(unsigned int sector_id) {
  */
 void SerialInterface::burn_block(unsigned int sector_addr, const QByteArray& data) {
     try {
-        qDebug() << "Burning block.";
+        TRACE_DEBUG(trace_serial) << "Burning block.";
 
         // calculate checksum
         uint8_t checksum = 0;
@@ -136,31 +368,156 @@ void SerialInterface::burn_block(unsigned int sector_addr, const QByteArray& dat
         }
 
         // display which checksum to expect
-        qDebug() << QString("Expecting checksum: 0x%1").arg(checksum, 2, 16).toStdString().c_str();
-
-        // construct command
-        std::string command = (boost::format("WRBK%04X") % sector_addr).str();
+        TRACE_DEBUG(trace_serial) << QString("Expecting checksum: 0x%1").arg(checksum, 2, 16).toStdString().c_str();
 
-        // send command to serial interface
-        this->send_command(command);
+        // construct command; the data is sent as soon as the echo is received
+        SerialCommand cmd;
+        cmd.command = QByteArray::fromStdString((boost::format("WRBK%04X") % sector_addr).str());
+        cmd.payload = data.left(0x100);
+        cmd.nrbytes = 1;
+        cmd.timeout = SERIAL_TIMEOUT_BLOCK;
 
-        this->port->write(data, 256);
-        while(this->port->waitForBytesWritten(SERIAL_TIMEOUT_BLOCK)){}
-
-        this->wait_for_response(1);
-        auto response = this->port->readAll();
+        auto response = this->engine->execute(cmd);
 
         if((uint8_t)response.data()[0] != checksum) {
-            qCritical() << "Invalid checksum received: " << checksum << " versus " << response[0];
+            TRACE_CRITICAL(trace_serial) << "Invalid checksum received: " << checksum << " versus " << response[0];
             throw std::runtime_error("Invalid checksum received");
         } else {
-            qDebug() << QString("Valid checksum received: 0x%1").arg(checksum, 2, 16).toStdString().c_str();
+            TRACE_DEBUG(trace_serial) << QString("Valid checksum received: 0x%1").arg(checksum, 2, 16).toStdString().c_str();
         }
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        throw e;
+    }
+}
 
-        // discard any contents still left in read buffer
-        this->flush_buffer();
+/**
+ * @brief Burn block (256 bytes) to SST39SF0x0 chip and read it back
+ * @param start address
+ * @param data (256 bytes)
+ * @return CRC-16 (CCITT) of the block as read back from the chip
+ */
+uint16_t SerialInterface::burn_block_verify(unsigned int sector_addr, const QByteArray& data) {
+    try {
+        // calculate checksum
+        uint8_t checksum = 0;
+        for(int i=0; i<data.size(); i++) {
+            checksum += data[i];
+        }
+
+        QByteArray checksum_response;
+        QByteArray readback;
+
+        SerialCommand write_cmd;
+        write_cmd.command = QByteArray::fromStdString((boost::format("WRBK%04X") % sector_addr).str());
+        write_cmd.payload = data.left(0x100);
+        write_cmd.nrbytes = 1;
+        write_cmd.timeout = SERIAL_TIMEOUT_BLOCK;
+        write_cmd.on_complete = [&checksum_response](const QByteArray& response) {
+            checksum_response = response;
+        };
+
+        SerialCommand read_cmd;
+        read_cmd.command = QByteArray::fromStdString((boost::format("RDBK%04X") % sector_addr).str());
+        read_cmd.nrbytes = 0x100;
+        read_cmd.timeout = SERIAL_TIMEOUT_BLOCK;
+        read_cmd.on_complete = [&readback](const QByteArray& response) {
+            readback = response;
+        };
+
+        this->engine->set_max_in_flight(2);
+        this->engine->submit(write_cmd);
+        this->engine->submit(read_cmd);
+        this->engine->wait_for_idle();
+        this->engine->set_max_in_flight(1);
+
+        if((uint8_t)checksum_response[0] != checksum) {
+            TRACE_CRITICAL(trace_serial) << "Invalid checksum received: " << checksum << " versus " << checksum_response[0];
+            throw std::runtime_error("Invalid checksum received");
+        }
+
+        return qChecksum(readback.constData(), readback.size());
     }  catch (std::exception& e) {
         std::cerr << "Caught error: " << e.what() << std::endl;
+        this->engine->set_max_in_flight(1);
+        throw e;
+    }
+}
+
+/**
+ * @brief Queue the erase of a sector (4096 bytes) without waiting for it
+ * @param addr start address
+ * @param on_done callback invoked once the sector is erased
+ */
+void SerialInterface::queue_erase_sector(unsigned int sector_id, const std::function<void()>& on_done) {
+    SerialCommand cmd;
+    cmd.command = QByteArray::fromStdString((boost::format("ESST%04X") % sector_id).str());
+    cmd.nrbytes = 2;
+    cmd.timeout = SERIAL_TIMEOUT_BLOCK;
+    cmd.on_complete = [sector_id, on_done](const QByteArray& response) {
+        uint16_t nrcycles = 0;
+        memcpy((void*)&nrcycles, (void*)&response.data()[0], 2);
+        TRACE_DEBUG(trace_serial) << "Succesfully erased sector " << sector_id << " in " << nrcycles << " cyles.";
+        if(on_done) {
+            on_done();
+        }
+    };
+
+    this->engine->set_max_in_flight(FLASH_WINDOW);
+    this->engine->submit(cmd);
+}
+
+/**
+ * @brief Queue burning and reading back a block (256 bytes) without waiting for it
+ * @param addr start address
+ * @param data (256 bytes)
+ * @param on_done callback invoked with acknowledgement and CRC-16 of the read back block
+ */
+void SerialInterface::queue_burn_block_verify(unsigned int sector_addr, const QByteArray& data,
+                                              const std::function<void(bool, uint16_t)>& on_done) {
+    uint8_t checksum = 0;
+    for(int i=0; i<data.size(); i++) {
+        checksum += data[i];
+    }
+
+    // the acknowledgement is always received before the read back data
+    auto acknowledged = std::make_shared<bool>(false);
+
+    SerialCommand write_cmd;
+    write_cmd.command = QByteArray::fromStdString((boost::format("WRBK%04X") % sector_addr).str());
+    write_cmd.payload = data.left(0x100);
+    write_cmd.nrbytes = 1;
+    write_cmd.timeout = SERIAL_TIMEOUT_BLOCK;
+    write_cmd.on_complete = [acknowledged, checksum](const QByteArray& response) {
+        *acknowledged = (uint8_t)response[0] == checksum;
+        if(!*acknowledged) {
+            TRACE_CRITICAL(trace_serial) << "Invalid checksum received: " << checksum << " versus " << response[0];
+        }
+    };
+
+    SerialCommand read_cmd;
+    read_cmd.command = QByteArray::fromStdString((boost::format("RDBK%04X") % sector_addr).str());
+    read_cmd.nrbytes = 0x100;
+    read_cmd.timeout = SERIAL_TIMEOUT_BLOCK;
+    read_cmd.on_complete = [acknowledged, on_done](const QByteArray& response) {
+        on_done(*acknowledged, qChecksum(response.constData(), response.size()));
+    };
+
+    this->engine->set_max_in_flight(FLASH_WINDOW);
+    this->engine->submit(write_cmd);
+    this->engine->submit(read_cmd);
+}
+
+/**
+ * @brief Execute all queued commands
+ */
+void SerialInterface::wait_for_queue() {
+    try {
+        this->engine->wait_for_idle();
+        this->engine->set_max_in_flight(1);
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        this->engine->set_max_in_flight(1);
         throw e;
     }
 }
@@ -170,10 +527,19 @@ void SerialInterface::burn_block(unsigned int sector_addr, const QByteArray& dat
  * @return chip id
  */
 uint16_t SerialInterface::get_chip_id() {
+    if(this->chip_id != 0) {
+        return this->chip_id;
+    }
+
     try {
         std::string command = "DEVIDSST";
         auto response = this->send_command_capture_response(command, 2);
         uint16_t chip_id = (uint16_t)(response[0]+1) * 256 + (uint16_t)response[1];
+
+        // only cache a recognized chip such that a fixed cartridge is picked up directly
+        if(ChipDescriptor::find(chip_id) != nullptr) {
+            this->chip_id = chip_id;
+        }
         return chip_id;
     }  catch (std::exception& e) {
         std::cerr << "Caught error: " << e.what() << std::endl;
@@ -207,22 +573,7 @@ void SerialInterface::write_address(uint16_t address, uint8_t value) {
  * @param command to send
  */
 void SerialInterface::send_command(const std::string& command) {
-    // send the command
-    qDebug() << "Send command: " << command.c_str();
-    this->port->write(command.c_str(), 8);
-    while(this->port->waitForBytesWritten(SERIAL_TIMEOUT)){}
-
-    // capture command response
-    this->wait_for_response(8);
-    auto response = this->port->readAll();
-
-    // check that response is identifical to command,
-    // else throw an error
-    if(strcmp(response.toStdString().c_str(), command.c_str()) != 0) {
-        throw std::runtime_error("Invalid response received (" + response.toStdString() + ") from command " + command);
-    } else {
-        qDebug() << "Response succesfully received: " << response;
-    }
+    this->send_command_capture_response(command, 0);
 }
 
 /**
@@ -230,30 +581,175 @@ void SerialInterface::send_command(const std::string& command) {
  * @param command to send
  */
 QByteArray SerialInterface::send_command_capture_response(const std::string& command, int nrbytes) {
-    // send the command
-    qDebug() << "Send command: " << command.c_str();
-    this->port->write(command.c_str(), 8);
-    while(this->port->waitForBytesWritten(SERIAL_TIMEOUT)){}
+    SerialCommand cmd;
+    cmd.command = QByteArray::fromStdString(command);
+    cmd.nrbytes = nrbytes;
+    cmd.timeout = SERIAL_TIMEOUT_COMMAND;
 
-    // capture command response
-    this->wait_for_response(8 + nrbytes);
+    // the engine verifies the echo and throws on an invalid or missing response
+    auto response = this->engine->execute(cmd);
 
-    // read bytes from port
-    auto response = this->port->readAll();
+    TRACE_DEBUG(trace_serial) << "Done, returning " << response.size() << " bytes.";
+    return response;
+}
 
-    // separate command and response
-    auto cmdres = response.mid(0,8);
-    response = response.mid(8,nrbytes);
+/**
+ * @brief Read a range of the EEPROM of the board
+ * @param addr start address
+ * @param nrbytes number of bytes
+ * @return EEPROM data (including pending writes)
+ */
+QByteArray SerialInterface::read_eeprom(uint16_t addr, unsigned int nrbytes) {
+    if(addr + nrbytes > EEPROM_SIZE) {
+        throw std::runtime_error("EEPROM range out of bounds");
+    }
 
-    // verify response
-    if(strcmp(cmdres.toStdString().c_str(), command.c_str()) != 0) {
-        throw std::runtime_error("Invalid response received (" + response.toStdString() + ") from command " + command);
-    } else {
-        qDebug() << "Response succesfully received: " << cmdres;
+    if(this->eeprom_cache.isEmpty()) {
+        this->eeprom_cache.fill(0xFF, EEPROM_SIZE);
+        this->eeprom_valid.assign(EEPROM_SIZE, false);
+        this->eeprom_dirty.assign(EEPROM_SIZE, false);
     }
 
-    qDebug() << "Done, returning " << response.size() << " bytes.";
-    return response;
+    // the probe itself reads the first byte of the EEPROM
+    bool ranged = this->probe_eeprom_access();
+
+    try {
+        // request every run of bytes that are not cached yet in a single transaction
+        unsigned int i = addr;
+        while(i < addr + nrbytes) {
+            if(this->eeprom_valid[i]) {
+                i++;
+                continue;
+            }
+
+            unsigned int start = i;
+            while(i < addr + nrbytes && !this->eeprom_valid[i] && i - start < EEPROM_CHUNK) {
+                i++;
+            }
+
+            if(ranged) {
+                SerialCommand cmd;
+                cmd.command = QByteArray::fromStdString((boost::format("REP%03X%02X") % start % ((i - start) & 0xFF)).str());
+                cmd.nrbytes = i - start;
+                cmd.timeout = SERIAL_TIMEOUT_COMMAND;
+                cmd.on_complete = [this, start](const QByteArray& data) {
+                    for(int j=0; j<data.size(); j++) {
+                        if(!this->eeprom_dirty[start + j]) {
+                            this->eeprom_cache[start + j] = data[j];
+                        }
+                        this->eeprom_valid[start + j] = true;
+                    }
+                };
+                this->engine->submit(cmd);
+            } else {
+                for(unsigned int j=start; j<i; j++) {
+                    SerialCommand cmd;
+                    cmd.command = QByteArray::fromStdString((boost::format("RBEP%04X") % j).str());
+                    cmd.nrbytes = 1;
+                    cmd.timeout = SERIAL_TIMEOUT_COMMAND;
+                    cmd.on_complete = [this, j](const QByteArray& data) {
+                        if(!this->eeprom_dirty[j]) {
+                            this->eeprom_cache[j] = data[0];
+                        }
+                        this->eeprom_valid[j] = true;
+                    };
+                    this->engine->submit(cmd);
+                }
+            }
+        }
+
+        this->engine->set_max_in_flight(this->read_window);
+        this->engine->wait_for_idle();
+        this->engine->set_max_in_flight(1);
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        this->engine->set_max_in_flight(1);
+        throw e;
+    }
+
+    return this->eeprom_cache.mid(addr, nrbytes);
+}
+
+/**
+ * @brief Stage a write to the EEPROM of the board
+ * @param addr start address
+ * @param data data to write
+ */
+void SerialInterface::write_eeprom(uint16_t addr, const QByteArray& data) {
+    if((unsigned int)addr + (unsigned int)data.size() > EEPROM_SIZE) {
+        throw std::runtime_error("EEPROM range out of bounds");
+    }
+
+    if(this->eeprom_cache.isEmpty()) {
+        this->eeprom_cache.fill(0xFF, EEPROM_SIZE);
+        this->eeprom_valid.assign(EEPROM_SIZE, false);
+        this->eeprom_dirty.assign(EEPROM_SIZE, false);
+    }
+
+    for(int i=0; i<data.size(); i++) {
+        this->eeprom_cache[addr + i] = data[i];
+        this->eeprom_dirty[addr + i] = true;
+    }
+}
+
+/**
+ * @brief Write all staged EEPROM changes to the board
+ */
+void SerialInterface::commit_eeprom() {
+    if(std::find(this->eeprom_dirty.begin(), this->eeprom_dirty.end(), true) == this->eeprom_dirty.end()) {
+        return;
+    }
+
+    if(!this->probe_eeprom_access()) {
+        throw std::runtime_error("Firmware does not support writing the EEPROM");
+    }
+
+    try {
+        unsigned int i = 0;
+        while(i < EEPROM_SIZE) {
+            if(!this->eeprom_dirty[i]) {
+                i++;
+                continue;
+            }
+
+            unsigned int start = i;
+            while(i < EEPROM_SIZE && this->eeprom_dirty[i] && i - start < EEPROM_CHUNK) {
+                i++;
+            }
+
+            // the board answers with the additive checksum of the received data
+            SerialCommand cmd;
+            cmd.command = QByteArray::fromStdString((boost::format("WEP%03X%02X") % start % ((i - start) & 0xFF)).str());
+            cmd.payload = this->eeprom_cache.mid(start, i - start);
+            cmd.nrbytes = 1;
+            cmd.timeout = SERIAL_TIMEOUT_COMMAND;
+            uint8_t checksum = 0;
+            for(char c : cmd.payload) {
+                checksum += (uint8_t)c;
+            }
+            const unsigned int end = i;
+            cmd.on_complete = [this, start, end, checksum](const QByteArray& data) {
+                if((uint8_t)data[0] != checksum) {
+                    TRACE_CRITICAL(trace_serial) << "Checksum mismatch writing EEPROM at " << start;
+                    return;
+                }
+                for(unsigned int j=start; j<end; j++) {
+                    this->eeprom_dirty[j] = false;
+                    this->eeprom_valid[j] = true;
+                }
+            };
+            this->engine->submit(cmd);
+        }
+
+        this->engine->wait_for_idle();
+    }  catch (std::exception& e) {
+        std::cerr << "Caught error: " << e.what() << std::endl;
+        throw e;
+    }
+
+    if(std::find(this->eeprom_dirty.begin(), this->eeprom_dirty.end(), true) != this->eeprom_dirty.end()) {
+        throw std::runtime_error("Could not verify EEPROM write");
+    }
 }
 
 /**
@@ -262,53 +758,71 @@ QByteArray SerialInterface::send_command_capture_response(const std::string& com
  * @return dword
  */
 uint32_t SerialInterface::get_variable_eeprom(uint16_t addr) {
-    uint32_t value = 0;
+    QByteArray data = this->read_eeprom(addr, 4);
 
+    // little endian encoding
+    uint32_t value = 0;
     for(int i=0; i<4; i++) {
-        std::string command = (boost::format("RBEP%04X") % (addr+i)).str();
-        auto response = this->send_command_capture_response(command.c_str(), 1);
-
-        // little endian encoding
-        value += response[0] * std::pow(256, i);
+        value |= (uint32_t)(uint8_t)data[i] << (8 * i);
     }
 
     return value;
 }
 
-
 /**
- * @brief Capture any bytes left in read buffer and destroy them
+ * @brief Stage a variable to be stored in EEPROM at address addr
+ * @param addr
+ * @param value dword
  */
-void SerialInterface::flush_buffer() {
-    QByteArray response;
+void SerialInterface::set_variable_eeprom(uint16_t addr, uint32_t value) {
+    QByteArray data(4, 0);
 
-    if(this->port->waitForReadyRead(SERIAL_TIMEOUT)) {
-        response += this->port->readAll(); //discard bytes
+    // little endian encoding
+    for(int i=0; i<4; i++) {
+        data[i] = (value >> (8 * i)) & 0xFF;
     }
 
-    if(response.size() > 0) {
-        qDebug() << "Flushing buffer, discarding the following bytes: " << response;
-    }
+    this->write_eeprom(addr, data);
 }
 
 /**
- * @brief Convenience function waiting for response
+ * @brief Determine whether the firmware supports ranged EEPROM access
+ * @return whether REP/WEP are supported
  */
-void SerialInterface::wait_for_response(int nrbytes) {
-    size_t ctr = 0;
-    int bytes_available = 0;
-    while(this->port->waitForReadyRead(SERIAL_TIMEOUT) || this->port->bytesAvailable() < nrbytes){
-        // check if number of bytes available is increasing, if not, increment counter
-        if(this->port->bytesAvailable() == bytes_available) {
-            ctr++;
-        }
-        bytes_available = this->port->bytesAvailable();
+bool SerialInterface::probe_eeprom_access() {
+    if(this->eeprom_access != EepromAccess::UNKNOWN) {
+        return this->eeprom_access == EepromAccess::RANGE;
+    }
 
-        // if counter reaches a maximum number of tries, terminate the procedure
-        if(ctr > 10) {
-            qDebug() << "Failed to capture response, outputting buffer:";
-            qDebug() << this->port->readAll();
-            throw std::runtime_error("Too many tries waiting for response to command, terminating.");
+    // older firmware does not answer the ranged command; it either stays silent or
+    // only echoes the command, such that the probe runs into its deadline
+    SerialCommand cmd;
+    cmd.command = "REP00001";
+    cmd.nrbytes = 1;
+    cmd.timeout = SERIAL_TIMEOUT_PROBE;
+    try {
+        QByteArray data = this->engine->execute(cmd);
+        if(!this->eeprom_dirty[0]) {
+            this->eeprom_cache[0] = data[0];
         }
+        this->eeprom_valid[0] = true;
+        this->eeprom_access = EepromAccess::RANGE;
+    }  catch (std::exception& e) {
+        TRACE_INFO(trace_serial) << "Firmware does not support ranged EEPROM access, falling back to RBEP.";
+        this->flush_buffer();
+        this->eeprom_access = EepromAccess::BYTE;
+    }
+
+    return this->eeprom_access == EepromAccess::RANGE;
+}
+
+/**
+ * @brief Capture any bytes left in read buffer and destroy them
+ */
+void SerialInterface::flush_buffer() {
+    QByteArray response = this->engine->drain(SERIAL_TIMEOUT);
+
+    if(response.size() > 0) {
+        TRACE_DEBUG(trace_serial) << "Flushing buffer, discarding the following bytes: " << response;
     }
 }
@@ -23,6 +23,8 @@
 
 #include <QSerialPort>
 #include <QSerialPortInfo>
+#include <QCoreApplication>
+#include <QThread>
 #include <QDateTime>
 #include <QDebug>
 
@@ -33,6 +35,12 @@
 #include <vector>
 #include <unordered_map>
 #include <chrono>
+#include <functional>
+#include <algorithm>
+
+#include "serial_command_engine.h"
+#include "serial_capture.h"
+#include "chipdescriptor.h"
 
 /**
  * @brief Interface class handling serial communication
@@ -43,9 +51,24 @@ private:
     static const unsigned int SERIAL_TIMEOUT = 100;             // timeout for regular serial communication
     static const unsigned int SERIAL_TIMEOUT_SECTOR = 0;        // timeout when reading sector data (0x1000 bytes)
     static const unsigned int SERIAL_TIMEOUT_BLOCK = 3000;      // timeout when reading sector data (0x1000 bytes)
+    static const unsigned int SERIAL_TIMEOUT_COMMAND = 1000;    // deadline for the board to answer a regular command
+    static const unsigned int READ_WINDOW = 4;                  // default number of block requests kept in flight
+    static const unsigned int FLASH_WINDOW = 4;                 // number of flash commands kept in flight
+    static const unsigned int SERIAL_TIMEOUT_PROBE = 250;       // deadline for a board to answer an optional command
+    static const unsigned int EEPROM_SIZE = 0x400;              // size of the EEPROM of the 32u4
+    static const unsigned int EEPROM_CHUNK = 0x100;             // maximum number of bytes per ranged EEPROM command
     std::string portname;                                       // communication port address
-    std::unique_ptr<QSerialPort> port;                          // pointer to QSerialPort object
+    std::unique_ptr<QIODevice> port;                            // device the engine communicates through
+    QSerialPort* serial_port = nullptr;                         // serial port (owned by port), nullptr when replaying
+    std::string capture_file;                                   // records the traffic of the session when set
+    std::string replay_file;                                    // replays a recorded session instead of using the port
+    bool replay_timed = true;                                   // replay with the timing of the recorded session
+    std::unique_ptr<SerialCommandEngine> engine;                // executes commands on the port
     int baudrate;
+    unsigned int read_window = READ_WINDOW;                     // number of block requests kept in flight
+    std::function<void(const SerialCommandTiming&)> timing_sink;    // receives command timings
+    bool persistent = false;                                    // keep the port open across operations
+    std::shared_ptr<CancellationToken> token;                   // cancellation of the current operation
 
     // variables to store cartridge firmware version
     int firmware_major = 0;
@@ -54,6 +77,21 @@ private:
     std::string firmware_version;
     std::string chipset;
 
+    // identity of board and chip, cached for the duration of a session
+    std::string board_info;
+    uint16_t chip_id = 0;
+
+    // EEPROM contents of the board, cached for the duration of a session
+    enum class EepromAccess {
+        UNKNOWN,        // not yet probed
+        BYTE,           // only single-byte reads (RBEP)
+        RANGE,          // ranged reads and writes (REP/WEP)
+    };
+    EepromAccess eeprom_access = EepromAccess::UNKNOWN;
+    QByteArray eeprom_cache;                                    // cached EEPROM contents
+    std::vector<bool> eeprom_valid;                             // whether a cached byte has been read
+    std::vector<bool> eeprom_dirty;                             // whether a cached byte awaits write-back
+
 public:
     /**
      * @brief SerialInterface
@@ -69,18 +107,114 @@ public:
         return this->portname;
     }
 
+    /**
+     * @brief Set the number of block requests that are kept in flight
+     *        when reading multiple blocks
+     * @param _read_window number of outstanding requests (at least 1)
+     */
+    inline void set_read_window(unsigned int _read_window) {
+        this->read_window = std::max(1u, _read_window);
+    }
+
+    /**
+     * @brief Set a callback receiving the timing of every completed command
+     * @param _timing_sink callback, nullptr to disable
+     *
+     * This is intended for benchmarking; the sink is called from the thread
+     * that performs the serial communication.
+     */
+    void set_timing_sink(const std::function<void(const SerialCommandTiming&)>& _timing_sink);
+
+    /**
+     * @brief Record all traffic of the next sessions to a binary log
+     * @param _capture_file log file (appended), empty to disable
+     *
+     * The log can be served back by set_replay_file, e.g. to reproduce a
+     * failure or to benchmark the protocol handling offline.
+     */
+    inline void set_capture_file(const std::string& _capture_file) {
+        this->capture_file = _capture_file;
+    }
+
+    /**
+     * @brief Serve a recorded session instead of communicating with a board
+     * @param _replay_file log file, empty to use the serial port
+     * @param _timed reproduce the timing of the recorded board rather than
+     *        responding immediately
+     */
+    inline void set_replay_file(const std::string& _replay_file, bool _timed = true) {
+        this->replay_file = _replay_file;
+        this->replay_timed = _timed;
+    }
+
+    /**
+     * @brief Set the token used to cancel the current operation
+     * @param _token token, nullptr to disable
+     *
+     * The token is released when the port is closed at the end of the operation.
+     */
+    void set_cancellation_token(const std::shared_ptr<CancellationToken>& _token);
+
+    /**
+     * @brief Keep the port open across operations
+     * @param _persistent whether close_port keeps the session alive
+     *
+     * In a persistent session, close_port hands the open port back to the
+     * main thread rather than closing it, such that the next operation does
+     * not need to reopen the port and identify board and chip again. Every
+     * worker thread must be handed the port via move_to_thread before it
+     * calls open_port.
+     */
+    inline void set_persistent(bool _persistent) {
+        this->persistent = _persistent;
+    }
+
+    /**
+     * @brief Whether a session is open
+     */
+    inline bool is_open() const {
+        return this->port && this->port->isOpen();
+    }
+
     /**
      * @brief Create a new QSerialPort object and specify
      *        communication settings
+     *
+     * An open session is reused when its port is still healthy.
      */
     void open_port();
 
     /**
      * @brief Close the communication port and destroy
      *        the QSerialPort object
+     *
+     * For persistent sessions, the port is kept open and moved to the main
+     * thread instead.
      */
     void close_port();
 
+    /**
+     * @brief Close the communication port regardless of persistence, e.g.
+     *        after an error left the port in an unknown state
+     */
+    void disconnect_port();
+
+    /**
+     * @brief Hand the open port to the thread that performs the next operation
+     * @param thread worker thread
+     *
+     * Must be called from the thread that currently owns the port, i.e.
+     * the main thread for a persistent session between operations.
+     */
+    void move_to_thread(QThread* thread);
+
+    /**
+     * @brief Check that the board still responds and refresh the chip id
+     * @return whether the session is alive; on failure, the port is closed
+     *         and will be reopened by the next operation
+     */
+    bool keepalive();
+
     /********************************************************
      *  Cardreader interfacing routines
      ********************************************************/
@@ -98,12 +232,72 @@ public:
      */
     QByteArray read_block(unsigned int sector_addr);
 
+    /**
+     * @brief Read a contiguous range of blocks (0x100 bytes each) from cartridge
+     *
+     * Rather than waiting for every block to arrive before requesting the next
+     * one, up to read_window RDBK requests are kept in flight by the command
+     * engine. The responses
+     * are returned by the board in the order in which they were requested and
+     * every block is copied straight to its position in the result.
+     *
+     * @param block_addr address of the first block
+     * @param nr_blocks number of blocks to read
+     * @param block_done optional callback invoked with the (relative) block id
+     *        once a block has been received
+     * @return data of all blocks
+     */
+    QByteArray read_blocks(unsigned int block_addr, unsigned int nr_blocks,
+                           const std::function<void(unsigned int)>& block_done = nullptr);
+
+    /**
+     * @brief Stream a contiguous range of blocks (0x100 bytes each) from cartridge
+     *
+     * Identical to read_blocks, but rather than collecting the data, every
+     * block is handed to the sink as soon as it arrives. The sink receives a
+     * view into the receive buffer which is only valid during the call.
+     *
+     * @param block_addr address of the first block
+     * @param nr_blocks number of blocks to read
+     * @param sink callback invoked with the (relative) block id and block data
+     */
+    void stream_blocks(unsigned int block_addr, unsigned int nr_blocks,
+                       const std::function<void(unsigned int, const SerialResponseView&)>& sink);
+
+    /**
+     * @brief Read an arbitrary set of blocks (0x100 bytes each) from cartridge
+     *
+     * All requests are pipelined in the same way as for a contiguous range.
+     *
+     * @param block_addrs addresses of the blocks
+     * @return data of all blocks, in the order of the addresses
+     */
+    QByteArray read_block_list(const std::vector<unsigned int>& block_addrs);
+
+    /**
+     * @brief Stream an arbitrary set of blocks (0x100 bytes each) from cartridge
+     * @param block_addrs addresses of the blocks
+     * @param sink callback invoked with the index of the block in the list and block data
+     */
+    void stream_block_list(const std::vector<unsigned int>& block_addrs,
+                           const std::function<void(unsigned int, const SerialResponseView&)>& sink);
+
     /**
      * @brief Erase sector (4096 bytes) on SST39SF0x0 chip
      * @param start address
      */
     void erase_sector(unsigned int addr);
 
+    /**
+     * @brief Erase the complete SST39SF0x0 chip
+     *
+     * Issues the JEDEC chip-erase sequence through single byte writes and
+     * waits for the erase to finish.
+     *
+     * @param erase_time maximum duration of the chip erase in ms
+     */
+    void erase_chip(unsigned int erase_time);
+
     /**
      * @brief Burn block (256 bytes) to SST39SF0x0 chip
      * @param start address
@@ -111,14 +305,107 @@ public:
      */
     void burn_block(unsigned int addr, const QByteArray& data);
 
+    /**
+     * @brief Burn block (256 bytes) to SST39SF0x0 chip and read it back
+     *
+     * The read-back request is queued directly behind the data of the write
+     * request such that both are handled in a single round trip.
+     *
+     * @param start address
+     * @param data (256 bytes)
+     * @return CRC-16 (CCITT) of the block as read back from the chip
+     */
+    uint16_t burn_block_verify(unsigned int addr, const QByteArray& data);
+
+    /**
+     * @brief Queue the erase of a sector (4096 bytes) without waiting for it
+     *
+     * Queued commands are kept in flight by the command engine, such that the
+     * board can continue with the next command as soon as the previous one is
+     * finished. Use wait_for_queue to execute them.
+     *
+     * @param addr start address
+     * @param on_done callback invoked once the sector is erased
+     */
+    void queue_erase_sector(unsigned int addr, const std::function<void()>& on_done = nullptr);
+
+    /**
+     * @brief Queue burning and reading back a block (256 bytes) without waiting for it
+     * @param addr start address
+     * @param data (256 bytes)
+     * @param on_done callback invoked with whether the board acknowledged the
+     *        data and the CRC-16 (CCITT) of the block as read back from the chip
+     */
+    void queue_burn_block_verify(unsigned int addr, const QByteArray& data,
+                                 const std::function<void(bool, uint16_t)>& on_done);
+
+    /**
+     * @brief Execute all queued commands
+     *
+     * Throws when any of the commands has failed; the remaining commands are
+     * discarded in that case.
+     */
+    void wait_for_queue();
+
     /**
      * @brief get_chip_id check to verify this is a SST39SF0x0 chip
-     * @return chip id
+     * @return chip id (cached for the duration of the session)
      */
     uint16_t get_chip_id();
 
+    /**
+     * @brief Read a range of the EEPROM of the board
+     *
+     * Bytes that are not cached are fetched in a single transaction, using
+     * the ranged REP command when the firmware supports it or else by
+     * pipelined RBEP commands.
+     *
+     * @param addr start address
+     * @param nrbytes number of bytes
+     * @return EEPROM data (including pending writes)
+     */
+    QByteArray read_eeprom(uint16_t addr, unsigned int nrbytes);
+
+    /**
+     * @brief Stage a write to the EEPROM of the board
+     *
+     * The data is only transferred to the board by commit_eeprom.
+     *
+     * @param addr start address
+     * @param data data to write
+     */
+    void write_eeprom(uint16_t addr, const QByteArray& data);
+
+    /**
+     * @brief Write all staged EEPROM changes to the board
+     *
+     * Contiguous changes are written by a single WEP command each; this
+     * requires firmware supporting ranged EEPROM access.
+     */
+    void commit_eeprom();
+
+    /**
+     * @brief get variable stored in EEPROM at address addr
+     * @param addr
+     * @return dword
+     */
+    uint32_t get_variable_eeprom(uint16_t addr);
+
+    /**
+     * @brief Stage a variable to be stored in EEPROM at address addr
+     * @param addr
+     * @param value dword
+     */
+    void set_variable_eeprom(uint16_t addr, uint32_t value);
+
 private:
 
+    /**
+     * @brief Determine whether the firmware supports ranged EEPROM access
+     * @return whether REP/WEP are supported
+     */
+    bool probe_eeprom_access();
+
     /**
      * @brief Write single byte to address
      * @param address to write at
@@ -139,22 +426,10 @@ private:
      */
     QByteArray send_command_capture_response(const std::string& command, int nrbytes);
 
-    /**
-     * @brief get variable stored in EEPROM at address addr
-     * @param addr
-     * @return dword
-     */
-    uint32_t get_variable_eeprom(uint16_t addr);
-
     /**
      * @brief Capture any bytes left in read buffer and destroy them
      */
     void flush_buffer();
-
-    /**
-     * @brief Convenience function waiting for response
-     */
-    void wait_for_response(int nrbytes);
 };
 
 #endif // SerialInterface_H
@@ -0,0 +1,91 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "serial_ring_buffer.h"
+
+/**
+ * @brief Constructor
+ * @param capacity number of bytes, rounded up to a power of two
+ */
+SerialRingBuffer::SerialRingBuffer(size_t capacity) {
+    size_t size = 1;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    this->storage.resize(size);
+    this->mask = size - 1;
+}
+
+/**
+ * @brief Read all available data from a device, as far as it fits
+ * @param device device to read from
+ * @return number of bytes read
+ */
+qint64 SerialRingBuffer::read_from(QIODevice* device) {
+    qint64 total = 0;
+
+    // the free space wraps around the end of the storage at most once
+    while(!this->is_full()) {
+        const size_t start = this->tail & this->mask;
+        const size_t len = std::min(this->capacity() - this->size(), this->capacity() - start);
+        const qint64 nrbytes = device->read(this->storage.data() + start, len);
+        if(nrbytes <= 0) {
+            break;
+        }
+        this->tail += nrbytes;
+        total += nrbytes;
+        if((size_t)nrbytes < len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * @brief Compare received data against a reference
+ * @param offset position relative to the first unconsumed byte
+ * @param data reference data
+ * @param len number of bytes, offset + len may not exceed size()
+ * @return whether the data is identical
+ */
+bool SerialRingBuffer::equals(size_t offset, const char* data, size_t len) const {
+    const SerialResponseView received = this->view(offset, len);
+    return memcmp(received.segments[0], data, received.sizes[0]) == 0 &&
+           (received.sizes[1] == 0 || memcmp(received.segments[1], data + received.sizes[0], received.sizes[1]) == 0);
+}
+
+/**
+ * @brief Get a view of received data
+ * @param offset position relative to the first unconsumed byte
+ * @param len number of bytes, offset + len may not exceed size()
+ */
+SerialResponseView SerialRingBuffer::view(size_t offset, size_t len) const {
+    SerialResponseView view;
+    const size_t start = (this->head + offset) & this->mask;
+    const size_t first = std::min(len, this->capacity() - start);
+    view.segments[0] = this->storage.data() + start;
+    view.sizes[0] = first;
+    if(first < len) {
+        view.segments[1] = this->storage.data();
+        view.sizes[1] = len - first;
+    }
+    return view;
+}
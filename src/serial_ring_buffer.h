@@ -0,0 +1,157 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef SERIAL_RING_BUFFER_H
+#define SERIAL_RING_BUFFER_H
+
+#include <QIODevice>
+#include <QByteArray>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Non-owning view of received data
+ *
+ * As the receive buffer is circular, the data may consist of two segments.
+ * The view is only valid for the duration of the callback it is passed to.
+ */
+struct SerialResponseView {
+    const char* segments[2] = {nullptr, nullptr};
+    int sizes[2] = {0, 0};
+
+    /**
+     * @brief Total number of bytes
+     */
+    inline int size() const {
+        return this->sizes[0] + this->sizes[1];
+    }
+
+    /**
+     * @brief Copy the data to its destination
+     * @param dest destination, needs to hold size() bytes
+     */
+    inline void copy_to(char* dest) const {
+        for(int i=0; i<2; i++) {
+            if(this->sizes[i] > 0) {
+                memcpy(dest, this->segments[i], this->sizes[i]);
+                dest += this->sizes[i];
+            }
+        }
+    }
+
+    /**
+     * @brief Copy the data into a new byte array
+     */
+    inline QByteArray to_byte_array() const {
+        QByteArray data(this->size(), Qt::Uninitialized);
+        this->copy_to(data.data());
+        return data;
+    }
+};
+
+/**
+ * @brief Fixed-size circular receive buffer
+ *
+ * Data is read from the device straight into the preallocated storage and
+ * is consumed in place, such that no allocations take place while
+ * receiving.
+ */
+class SerialRingBuffer {
+
+private:
+    std::vector<char> storage;  // preallocated storage, size is a power of two
+    size_t mask;                // maps positions onto the storage
+    size_t head = 0;            // position of the first unconsumed byte
+    size_t tail = 0;            // position after the last received byte
+
+public:
+    /**
+     * @brief Constructor
+     * @param capacity number of bytes, rounded up to a power of two
+     */
+    SerialRingBuffer(size_t capacity);
+
+    /**
+     * @brief Number of received bytes that are not yet consumed
+     */
+    inline size_t size() const {
+        return this->tail - this->head;
+    }
+
+    /**
+     * @brief Maximum number of bytes that can be held
+     */
+    inline size_t capacity() const {
+        return this->storage.size();
+    }
+
+    inline bool is_full() const {
+        return this->size() == this->capacity();
+    }
+
+    /**
+     * @brief Read all available data from a device, as far as it fits
+     * @param device device to read from
+     * @return number of bytes read
+     */
+    qint64 read_from(QIODevice* device);
+
+    /**
+     * @brief Compare received data against a reference
+     * @param offset position relative to the first unconsumed byte
+     * @param data reference data
+     * @param len number of bytes, offset + len may not exceed size()
+     * @return whether the data is identical
+     */
+    bool equals(size_t offset, const char* data, size_t len) const;
+
+    /**
+     * @brief Get a view of received data
+     * @param offset position relative to the first unconsumed byte
+     * @param len number of bytes, offset + len may not exceed size()
+     */
+    SerialResponseView view(size_t offset, size_t len) const;
+
+    /**
+     * @brief Consume received data
+     * @param len number of bytes
+     */
+    inline void discard(size_t len) {
+        this->head += std::min(len, this->size());
+    }
+
+    /**
+     * @brief Discard all received data
+     */
+    inline void clear() {
+        this->head = this->tail;
+    }
+
+    /**
+     * @brief Copy all received data, e.g. for diagnostics
+     */
+    inline QByteArray to_byte_array() const {
+        return this->view(0, this->size()).to_byte_array();
+    }
+};
+
+#endif // SERIAL_RING_BUFFER_H
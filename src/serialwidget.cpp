@@ -15,6 +15,17 @@ SerialWidget::SerialWidget(QWidget *parent) : QWidget(parent) {
     connect(this->button_select_serial, SIGNAL (released()), this, SLOT (select_com_port()));
     connect(this->button_read_cartridge, SIGNAL (released()), this, SLOT (read_cartridge()));
     connect(this->button_write_cartridge, SIGNAL(released()), this, SLOT(flash_rom()));
+    connect(this->button_dump_chip, SIGNAL(released()), this, SLOT(dump_chip()));
+    connect(this->button_batch_flash, SIGNAL(released()), this, SLOT(flash_batch()));
+    connect(this->button_flash_all_readers, SIGNAL(released()), this, SLOT(flash_all_readers()));
+    connect(this->button_cancel, SIGNAL(released()), this, SLOT(cancel_operation()));
+
+    // keep the session with the cartridge reader alive in between operations
+    this->keepalive_timer.setInterval(KEEPALIVE_INTERVAL);
+    connect(&this->keepalive_timer, SIGNAL(timeout()), this, SLOT(keepalive()));
+
+    // progress of the worker threads is sampled rather than signalled per block
+    connect(&this->progress_monitor, SIGNAL(progress_updated(uint,uint,double)), this, SLOT(update_progress(uint,uint,double)));
 }
 
 /**
@@ -51,6 +62,20 @@ void SerialWidget::scan_com_devices() {
         }
     }
 
+    // simulated cartridge reader (see tools/cartsim), treated as a 32u4 board
+    QString simulator_port = qgetenv("P2K_SIMULATOR_PORT");
+    if(!simulator_port.isEmpty()) {
+        qInfo() << "Adding simulated cartridge reader at" << simulator_port;
+        ports.emplace(simulator_port.toStdString(), patterns[0]);
+    }
+
+    // recorded session (see SerialReplayDevice), served in place of a cartridge reader
+    QString replay_file = qgetenv("P2K_SERIAL_REPLAY");
+    if(!replay_file.isEmpty()) {
+        qInfo() << "Adding recorded session" << replay_file;
+        ports.emplace(replay_file.toStdString(), patterns[0]);
+    }
+
     // populate drop-down menu with valid ports
     for(const auto& item : ports) {
         this->combobox_serial_ports->addItem(item.first.c_str());
@@ -61,6 +86,7 @@ void SerialWidget::scan_com_devices() {
     if(this->combobox_serial_ports->count() > 0) {
         this->button_select_serial->setEnabled(true);
     }
+    this->button_flash_all_readers->setEnabled(this->combobox_serial_ports->count() > 1);
 
 
     if(port_identifiers.size() == 1) {
@@ -74,7 +100,8 @@ void SerialWidget::scan_com_devices() {
               "There are at least %1 devices that share the same id. Please ensure that only a single P2k-device is plugged in."
               " If multiple devices are plugged in, ensure you select the correct port. Please also note that the device id overlaps"
               " with the one from the Arduino Leonardo bootloader. If you have an Arduino Leonardo or compatible device plugged in,"
-              " take care to unplug it or carefully select the correct port."
+              " take care to unplug it or carefully select the correct port. To flash the cartridges in all readers"
+              " at once, use \"Write to all readers\"."
         ).arg(port_identifiers.size()));
         //msg_box.setWindowIcon(QIcon(":/assets/img/logo.ico"));
         msg_box.exec();
@@ -91,15 +118,39 @@ void SerialWidget::scan_com_devices() {
  * @brief Select communication port for serial to 32u4
  */
 void SerialWidget::select_com_port() {
+    if(this->is_keepalive_running()) {
+        return;
+    }
+
     auto port_id = this->port_identifiers[this->combobox_serial_ports->currentIndex()];
+    bool recorded = false;
+    this->keepalive_timer.stop();
 
     if(port_id == std::make_pair<uint16_t, uint16_t>(0x2341, 0x36)) {          // Arduino Leonardo / 32u4
         qDebug() << "Connecting to 32u4; setting baud rate to 115200.";
+        if(this->serial_interface) {
+            this->serial_interface->disconnect_port();
+        }
         this->serial_interface = std::make_shared<SerialInterface>(this->combobox_serial_ports->currentText().toStdString(), 115200);
+        this->serial_interface->set_persistent(true);
+
+        // record the traffic to reproduce failures offline, or replay such a recording;
+        // the keepalive is disabled for these sessions as its traffic depends on timing
+        QString capture_file = qgetenv("P2K_SERIAL_CAPTURE");
+        if(this->combobox_serial_ports->currentText() == QString(qgetenv("P2K_SERIAL_REPLAY"))) {
+            this->serial_interface->set_replay_file(this->combobox_serial_ports->currentText().toStdString());
+            recorded = true;
+        } else if(!capture_file.isEmpty()) {
+            this->serial_interface->set_capture_file(capture_file.toStdString());
+            recorded = true;
+        }
     } else {
         throw std::runtime_error("Invalid port id.");
     }
 
+    // contents of a previously used cartridge are no longer known
+    this->slot_cache.clear();
+
     this->serial_interface->open_port();
     std::string board_info = this->serial_interface->get_board_info();
     this->serial_interface->close_port();
@@ -108,7 +159,54 @@ void SerialWidget::select_com_port() {
     if(board_info.substr(0,9) == "Ph2k-32u4") {
         this->button_read_cartridge->setEnabled(true);
         this->button_write_cartridge->setEnabled(true);
+        this->button_dump_chip->setEnabled(true);
+        this->button_batch_flash->setEnabled(true);
+        if(!recorded) {
+            this->keepalive_timer.start();
+        }
+    }
+}
+
+/**
+ * @brief Check in between operations that the cartridge reader still responds
+ */
+void SerialWidget::keepalive() {
+    if(!this->serial_interface || this->is_busy() || this->in_keepalive) {
+        return;
+    }
+
+    // the check waits for the board in a local event loop, during which the
+    // operation slots must not hand the port to a worker thread
+    bool was_open = this->serial_interface->is_open();
+    this->in_keepalive = true;
+    bool alive = this->serial_interface->keepalive();
+    this->in_keepalive = false;
+    if(alive && !was_open) {
+        this->signal_emit_statusbar_message(tr("Reconnected to ") + this->combobox_serial_ports->currentText());
+    } else if(!alive && was_open) {
+        this->signal_emit_statusbar_message(tr("Lost connection to ") + this->combobox_serial_ports->currentText() + tr(", retrying."));
+    }
+}
+
+/**
+ * @brief Check whether the keepalive currently uses the port, such that no operation can be started
+ * @return whether the keepalive is in progress
+ */
+bool SerialWidget::is_keepalive_running() {
+    if(this->in_keepalive) {
+        this->signal_emit_statusbar_message(tr("Checking the connection to the cartridge reader, please try again."));
     }
+    return this->in_keepalive;
+}
+
+/**
+ * @brief Whether an operation on a cartridge reader is in progress
+ */
+bool SerialWidget::is_busy() const {
+    return (this->readerthread && this->readerthread->isRunning()) ||
+           (this->flashthread && this->flashthread->isRunning()) ||
+           (this->dumpthread && this->dumpthread->isRunning()) ||
+           (this->flashscheduler && this->flashscheduler->is_running());
 }
 
 /*****************************************************************************************************
@@ -121,6 +219,10 @@ void SerialWidget::select_com_port() {
  * @brief Read data from chip
  */
 void SerialWidget::read_cartridge() {
+    if(this->is_keepalive_running()) {
+        return;
+    }
+
     DialogSlotSelection dialog;
     int res = dialog.exec();
     if(res != QDialog::Accepted) {
@@ -132,50 +234,152 @@ void SerialWidget::read_cartridge() {
     qDebug() << "Selecting slot " << slot_id;
 
     this->timer1.start();
-    this->num_blocks = 64;
+    this->progress_bar_load->reset();
 
-    // disable all buttons so that the user cannot interrupt this task
+    // disable all buttons so that the user can only cancel this task
     this->disable_all_buttons();
 
     // dispatch thread
     this->readerthread = std::make_unique<ReadThread>(this->serial_interface);
     this->readerthread->set_rom_slot(slot_id);
     this->readerthread->set_serial_port(this->combobox_serial_ports->currentText().toStdString());
+    this->readerthread->set_use_slot_cache(this->checkbox_slot_cache->isChecked());
+    this->readerthread->set_deadline(READ_DEADLINE);
     connect(this->readerthread.get(), SIGNAL(read_result_ready()), this, SLOT(read_result_ready()));
-    connect(this->readerthread.get(), SIGNAL(read_block_start(uint)), this, SLOT(read_block_start(uint)));
-    connect(this->readerthread.get(), SIGNAL(read_block_done(uint)), this, SLOT(read_block_done(uint)));
+    connect(this->readerthread.get(), SIGNAL(read_error(const QString&)), this, SLOT(read_error(const QString&)));
+    this->serial_interface->move_to_thread(this->readerthread.get());
     this->readerthread->start();
+    this->progress_operation = QString("Reading slot %1,").arg(slot_id + 1);
+    this->progress_monitor.start(this->readerthread.get());
+}
+
+/*
+ * @brief Signal that a read operation is finished
+ */
+void SerialWidget::read_result_ready() {
+    this->progress_monitor.stop();
+    this->progress_bar_load->setValue(this->progress_bar_load->maximum());
+    this->data = this->readerthread->get_data();
+    this->slot_cache[this->readerthread->get_rom_slot()] = this->data;
+    if(this->readerthread->is_from_cache()) {
+        this->signal_emit_statusbar_message(QString("Ready - Slot %1 served from the slot cache (matched on sampled blocks only); "
+                                                    "uncheck \"Serve reads from the slot cache\" to force a full read.").arg(this->readerthread->get_rom_slot() + 1));
+    } else {
+        this->signal_emit_statusbar_message(QString("Ready - Done reading in %1 seconds.").arg((double)this->timer1.elapsed() / 1000));
+    }
+    this->readerthread.reset(); // delete object
+    this->signal_data_read();
+    this->enable_all_buttons();
+}
+
+/*
+ * @brief Signal that a read operation was aborted
+ */
+void SerialWidget::read_error(const QString& error_msg) {
+    this->progress_monitor.stop();
+    this->signal_emit_statusbar_message("Reading interrupted.");
+    QMessageBox msg_box;
+    msg_box.setIcon(QMessageBox::Warning);
+    msg_box.setText(tr("Could not read the cartridge. %1").arg(error_msg));
+    msg_box.exec();
+
+    this->progress_bar_load->reset();
+    this->enable_all_buttons();
 }
 
 /**
- * @brief Slot to accept when a sector is ready
+ * @brief Cancel the running operation
  */
-void SerialWidget::read_block_start(unsigned int sector_id) {
-    this->progress_bar_load->setMaximum(64);
-    this->progress_bar_load->setValue(sector_id);
+void SerialWidget::cancel_operation() {
+    this->signal_emit_statusbar_message(tr("Cancelling, finishing the current command..."));
+    this->button_cancel->setEnabled(false);
+
+    if(this->readerthread && this->readerthread->isRunning()) {
+        this->readerthread->cancel();
+    }
+    if(this->flashthread && this->flashthread->isRunning()) {
+        this->flashthread->cancel();
+    }
+    if(this->dumpthread && this->dumpthread->isRunning()) {
+        this->dumpthread->cancel();
+    }
+    if(this->flashscheduler) {
+        this->flashscheduler->cancel();
+    }
 }
 
+/*****************************************************************************************************
+ *
+ * CARTRIDGE DUMP FUNCTIONS
+ *
+ *****************************************************************************************************/
+
 /**
- * @brief Slot to accept when a sector is ready
+ * @brief Dump the complete chip to a file
  */
-void SerialWidget::read_block_done(unsigned int sector_id) {
-    double seconds_passed = (double)this->timer1.elapsed() / 1000.0;
-    double seconds_per_sector = seconds_passed / (double)(sector_id+1);
-    double seconds_remaining = seconds_per_sector * (this->num_blocks - sector_id - 1);
-    if(sector_id < (this->num_blocks - 1)) {
-        this->signal_emit_statusbar_message(QString("%1 sector %2 / %3 : %4 seconds remaining.").arg("Reading").arg(sector_id+1).arg(this->num_blocks).arg(seconds_remaining));
+void SerialWidget::dump_chip() {
+    if(this->is_keepalive_running()) {
+        return;
+    }
+
+    QString filename = QFileDialog::getSaveFileName(this, tr("Dump chip to file"),
+                                                    "",
+                                                    tr("Binary files (*.bin)"));
+
+    // do nothing if user has cancelled
+    if(filename.isEmpty()) {
+        return;
     }
-    this->progress_bar_load->setValue(sector_id+1);
+
+    this->timer1.start();
+    this->progress_bar_load->reset();
+
+    // disable all buttons so that the user can only cancel this task
+    this->disable_all_buttons();
+
+    // dispatch thread
+    this->dumpthread = std::make_unique<DumpThread>(this->serial_interface);
+    this->dumpthread->set_filename(filename);
+    this->dumpthread->set_deadline(DUMP_DEADLINE);
+    this->dumpthread->set_serial_port(this->combobox_serial_ports->currentText().toStdString());
+    connect(this->dumpthread.get(), SIGNAL(dump_started(uint)), this, SLOT(dump_started(uint)));
+    connect(this->dumpthread.get(), SIGNAL(dump_result_ready()), this, SLOT(dump_result_ready()));
+    connect(this->dumpthread.get(), SIGNAL(dump_error(const QString&)), this, SLOT(dump_error(const QString&)));
+    this->serial_interface->move_to_thread(this->dumpthread.get());
+    this->dumpthread->start();
+    this->progress_operation = "Dumping";
+    this->progress_monitor.start(this->dumpthread.get());
 }
 
-/*
- * @brief Signal that a read operation is finished
+/**
+ * @brief Slot to accept that the chip is identified and dumping starts
  */
-void SerialWidget::read_result_ready() {
+void SerialWidget::dump_started(unsigned int nr_blocks) {
+    this->progress_bar_load->setMaximum(nr_blocks);
+}
+
+/**
+ * @brief Signal that a dump operation is finished
+ */
+void SerialWidget::dump_result_ready() {
+    this->progress_monitor.stop();
     this->progress_bar_load->setValue(this->progress_bar_load->maximum());
-    this->data = this->readerthread->get_data();
-    this->readerthread.reset(); // delete object
-    this->signal_data_read();
+    this->signal_emit_statusbar_message("Ready - Done dumping in " + QString::number((double)this->timer1.elapsed() / 1000) + " seconds.");
+    this->dumpthread.reset(); // delete object
+    this->enable_all_buttons();
+}
+
+/**
+ * @brief Signal that a dump operation has failed
+ */
+void SerialWidget::dump_error(const QString& message) {
+    this->progress_monitor.stop();
+    QMessageBox msg_box;
+    msg_box.setIcon(QMessageBox::Warning);
+    msg_box.setText(tr("Could not dump the chip. %1").arg(message));
+    msg_box.exec();
+
+    this->dumpthread.reset(); // delete object
     this->enable_all_buttons();
 }
 
@@ -189,6 +393,10 @@ void SerialWidget::read_result_ready() {
  * @brief Put rom on flash cartridge
  */
 void SerialWidget::flash_rom() {
+    if(this->is_keepalive_running()) {
+        return;
+    }
+
     DialogSlotSelection dialog;
     int res = dialog.exec();
     if(res != QDialog::Accepted) {
@@ -203,124 +411,312 @@ void SerialWidget::flash_rom() {
     // perform data request
     this->signal_get_data();
 
-    // to save time upon the relatively slow flashing procedure, the cartridge is padded with zeros to
-    // fill the last block and only the required number of blocks are uploaded rather than the full
-    // 64 blocks of $100 bytes each.
-    QByteArray padding;
-    unsigned int nrblocks = (this->flash_data.size() / 0x100) + 1;
-    padding.fill(0, 0x100 * nrblocks - this->flash_data.size());
-    this->flash_data += padding;
+    this->flash_data = this->pad_flash_data(this->flash_data);
 
-    this->progress_bar_load->setMaximum(nrblocks);
-    this->flashthread = std::make_unique<FlashThread>(this->serial_interface);
-    this->flashthread->set_rom_slot(slot_id);
-    this->flashthread->set_serial_port(this->combobox_serial_ports->currentText().toStdString());
-    this->flashthread->set_data(this->flash_data);
+    this->start_flash({{slot_id, this->flash_data, QByteArray()}});
+}
 
-    connect(this->flashthread.get(), SIGNAL(flash_result_ready()), this, SLOT(flash_result_ready()));
-    connect(this->flashthread.get(), SIGNAL(flash_block_start(uint)), this, SLOT(flash_block_start(uint)));
-    connect(this->flashthread.get(), SIGNAL(flash_block_done(uint)), this, SLOT(flash_block_done(uint)));
-    connect(this->flashthread.get(), SIGNAL(flash_chip_id_error(uint)), this, SLOT(flash_chip_id_error(uint)));
-    flashthread->start();
+/**
+ * @brief Put several files on consecutive slots of the flash cartridge
+ */
+void SerialWidget::flash_batch() {
+    if(this->is_keepalive_running()) {
+        return;
+    }
 
-    // disable all buttons
+    QStringList filenames = QFileDialog::getOpenFileNames(this, tr("Select ROM images"), "", tr("Binary files (*.bin);;All files (*)"));
+    if(filenames.isEmpty()) {
+        return;
+    }
+
+    DialogSlotSelection dialog;
+    int res = dialog.exec();
+    if(res != QDialog::Accepted) {
+        qDebug() << "Cancelled operation.";
+        return;
+    }
+
+    // assign the files in the order as selected to consecutive slots; larger
+    // images occupy as many slots as needed
+    std::vector<FlashJob> jobs;
+    int slot_id = dialog.get_slot_id();
+    for(const QString& filename : filenames) {
+        QFile infile(filename);
+        if(!infile.open(QIODevice::ReadOnly)) {
+            QMessageBox::critical(this, tr("Error"), tr("Could not open %1.").arg(filename));
+            return;
+        }
+        QByteArray image = this->pad_flash_data(infile.readAll());
+        // the capacity of the chip is only known once its id has been read, hence it is
+        // verified by the flash thread before anything is erased
+        const int slot_size = ChipDescriptor::SLOT_SIZE;
+        int nr_slots = std::max(1, (image.size() + slot_size - 1) / slot_size);
+        jobs.push_back({slot_id, image, QByteArray()});
+        slot_id += nr_slots;
+    }
+
+    this->timer1.start();
+    this->start_flash(jobs);
+}
+
+/**
+ * @brief Put the current data on the cartridges in all detected readers
+ */
+void SerialWidget::flash_all_readers() {
+    if(this->is_keepalive_running()) {
+        return;
+    }
+
+    DialogSlotSelection dialog;
+    int res = dialog.exec();
+    if(res != QDialog::Accepted) {
+        qDebug() << "Cancelled operation.";
+        return;
+    }
+    int slot_id = dialog.get_slot_id();
+
+    bool ok = false;
+    int nr_cartridges = QInputDialog::getInt(this, tr("Write to all readers"), tr("Number of cartridges to flash:"),
+                                             this->combobox_serial_ports->count(), 1, 9999, 1, &ok);
+    if(!ok) {
+        return;
+    }
+
+    // perform data request
+    this->signal_get_data();
+    this->flash_data = this->pad_flash_data(this->flash_data);
+
+    // every reader, including the selected one, is driven by its own session
+    if(this->serial_interface) {
+        this->serial_interface->disconnect_port();
+    }
+
+    this->flashscheduler = std::make_unique<FlashScheduler>();
+    this->flashscheduler->set_differential(this->checkbox_differential->isChecked());
+    for(int i=0; i<this->combobox_serial_ports->count(); i++) {
+        this->flashscheduler->add_device(this->combobox_serial_ports->itemText(i).toStdString());
+    }
+    for(int i=0; i<nr_cartridges; i++) {
+        this->flashscheduler->add_job({{slot_id, this->flash_data, QByteArray()}});
+    }
+
+    // build a progress bar per reader
+    for(QLabel* label : this->device_labels) {
+        delete label;
+    }
+    for(QProgressBar* progress_bar : this->device_progress_bars) {
+        delete progress_bar;
+    }
+    this->device_labels.clear();
+    this->device_progress_bars.clear();
+    for(unsigned int i=0; i<this->flashscheduler->get_nr_devices(); i++) {
+        this->device_labels.push_back(new QLabel(this->flashscheduler->get_device_port(i).c_str()));
+        this->device_progress_bars.push_back(new QProgressBar());
+        this->layout_devices->addWidget(this->device_labels.back(), i, 0);
+        this->layout_devices->addWidget(this->device_progress_bars.back(), i, 1);
+    }
+    this->device_container->setVisible(true);
+
+    connect(this->flashscheduler.get(), SIGNAL(device_job_started(uint,uint)), this, SLOT(scheduler_job_started(uint,uint)));
+    connect(this->flashscheduler.get(), SIGNAL(device_progress(uint,uint,uint)), this, SLOT(scheduler_device_progress(uint,uint,uint)));
+    connect(this->flashscheduler.get(), SIGNAL(device_job_finished(uint,uint,bool,const QString&,bool)), this, SLOT(scheduler_job_finished(uint,uint,bool,const QString&,bool)));
+    connect(this->flashscheduler.get(), SIGNAL(scheduler_finished(uint,uint)), this, SLOT(scheduler_finished(uint,uint)));
+
+    this->timer1.start();
     this->disable_all_buttons();
+    this->flashscheduler->start();
+}
+
+/**
+ * @brief Slot to accept that a reader starts flashing a cartridge
+ */
+void SerialWidget::scheduler_job_started(unsigned int device_id, unsigned int job_id) {
+    this->device_labels[device_id]->setText(QString("%1 (#%2)").arg(this->flashscheduler->get_device_port(device_id).c_str()).arg(job_id + 1));
 }
 
 /**
- * @brief Slot to indicate that a page is about to be written
+ * @brief Slot to accept the progress of a reader
  */
-void SerialWidget::flash_block_start(unsigned int page_id) {
-    this->progress_bar_load->setValue(page_id);
+void SerialWidget::scheduler_device_progress(unsigned int device_id, unsigned int nr_blocks_done, unsigned int nr_blocks) {
+    this->device_progress_bars[device_id]->setMaximum(nr_blocks);
+    this->device_progress_bars[device_id]->setValue(nr_blocks_done);
 }
 
 /**
- * @brief Slot to accept that a page is written
+ * @brief Slot to accept that a reader has finished a cartridge
  */
-void SerialWidget::flash_block_done(unsigned int page_id) {
-    unsigned int num_pages = this->flash_data.size() / 0x100;
-    double seconds_passed = (double)this->timer1.elapsed() / 1000.0;
-    double seconds_per_page = seconds_passed / (double)(page_id+1);
-    double seconds_remaining = seconds_per_page * (num_pages - page_id - 1);
-    if(page_id < (num_pages - 1)) {
-        this->signal_emit_statusbar_message(QString("%1 page %2 / %3 : %4 seconds remaining.").arg("Flashing ").arg(page_id+1).arg(num_pages).arg(seconds_remaining));
+void SerialWidget::scheduler_job_finished(unsigned int device_id, unsigned int job_id, bool success, const QString& message, bool hold) {
+    const QString port = this->flashscheduler->get_device_port(device_id).c_str();
+    this->device_labels[device_id]->setText(QString("%1 (#%2): %3").arg(port).arg(job_id + 1).arg(success ? tr("done") : tr("FAILED")));
+    this->signal_emit_statusbar_message(QString("Cartridge #%1 in %2: %3").arg(job_id + 1).arg(port).arg(message));
+
+    if(hold) {
+        QMessageBox msg_box(success ? QMessageBox::Information : QMessageBox::Warning,
+                tr("Swap cartridge"),
+                tr("Cartridge #%1 in %2: %3\n\nInsert the next cartridge in %2 and press OK.").arg(job_id + 1).arg(port).arg(message),
+                QMessageBox::Ok, this);
+        msg_box.exec();
+        this->flashscheduler->release_device(device_id);
     }
-    this->progress_bar_load->setValue(page_id+1);
 }
 
-/*
- * @brief Signal that a flash operation is finished
+/**
+ * @brief Slot to accept that all cartridges are flashed
  */
-void SerialWidget::flash_result_ready() {
-    this->progress_bar_load->setValue(this->progress_bar_load->maximum());
-    this->signal_emit_statusbar_message("Ready - Done flashing in " + QString::number((double)this->timer1.elapsed() / 1000) + " seconds.");
+void SerialWidget::scheduler_finished(unsigned int nr_success, unsigned int nr_failed) {
+    this->signal_emit_statusbar_message(QString("Ready - Flashed %1 cartridges in %2 seconds.").arg(nr_success + nr_failed).arg((double)this->timer1.elapsed() / 1000));
+    QMessageBox msg_box(nr_failed == 0 ? QMessageBox::Information : QMessageBox::Warning,
+            "Flash complete",
+            tr("%1 cartridges were successfully flashed and verified, %2 failed.").arg(nr_success).arg(nr_failed),
+            QMessageBox::Ok, this);
+    msg_box.exec();
 
-    // dispatch thread
-    this->timer1.restart();
-    this->readerthread = std::make_unique<ReadThread>(this->serial_interface);
-    this->readerthread->set_rom_slot(this->flashthread->get_rom_slot());
-    this->readerthread->set_serial_port(this->combobox_serial_ports->currentText().toStdString());
+    this->enable_all_buttons();
+}
 
-    // set progress bar
-    this->progress_bar_load->reset();
-    this->num_blocks = this->flash_data.size() / 0x100;
-    this->readerthread->set_num_blocks(this->num_blocks);
-    this->progress_bar_load->setMaximum(this->num_blocks);
+/**
+ * @brief Pad data to full blocks
+ * @param data data to be flashed
+ * @return padded data
+ */
+QByteArray SerialWidget::pad_flash_data(const QByteArray& data) const {
+    // to save time upon the relatively slow flashing procedure, the data is padded to fill the last
+    // block and only the required number of blocks are uploaded rather than the full 64 blocks of
+    // $100 bytes each. By default, the padding byte is $FF such that padding matches erased flash
+    // and blank blocks are not transferred at all.
+    QByteArray padding;
+    const unsigned int block_size = ChipDescriptor::BLOCK_SIZE;
+    unsigned int nrblocks = (data.size() + block_size - 1) / block_size;
+    padding.fill(this->padding_byte, block_size * nrblocks - data.size());
+    return data + padding;
+}
+
+/**
+ * @brief Launch a flash thread for one or more slots
+ * @param jobs slots and their data
+ */
+void SerialWidget::start_flash(const std::vector<FlashJob>& jobs) {
+    this->flashthread = std::make_unique<FlashThread>(this->serial_interface);
+    this->flashthread->set_serial_port(this->combobox_serial_ports->currentText().toStdString());
+    this->flashthread->set_differential(this->checkbox_differential->isChecked());
+
+    bool interrupted = false;
+    for(const auto& job : jobs) {
+        // an image larger than a slot spans several slots, its reference is only known
+        // when all of these slots are known
+        const int nr_slots = std::max(1, (job.data.size() + (int)ChipDescriptor::SLOT_SIZE - 1) / (int)ChipDescriptor::SLOT_SIZE);
+        QByteArray reference;
+        for(int s=job.slot_id; s<job.slot_id + nr_slots; s++) {
+            const int needed = std::min((int)ChipDescriptor::SLOT_SIZE, job.data.size() - reference.size());
+            auto cached = this->slot_cache.find(s);
+            if(cached == this->slot_cache.end() || cached->second.size() < needed) {
+                reference.clear();
+                break;
+            }
+            reference.append(cached->second.left(needed));
+        }
+        this->flashthread->add_job(job.slot_id, job.data, reference);
 
-    connect(this->readerthread.get(), SIGNAL(read_result_ready()), this, SLOT(verify_result_ready()));
-    connect(this->readerthread.get(), SIGNAL(read_block_start(uint)), this, SLOT(verify_block_start(uint)));
-    connect(this->readerthread.get(), SIGNAL(read_block_done(uint)), this, SLOT(verify_block_done(uint)));
-    readerthread->start();
+        // contents are unknown until verified
+        for(int s=job.slot_id; s<job.slot_id + nr_slots; s++) {
+            this->slot_cache.erase(s);
+        }
+
+        FlashJournal journal(job.slot_id, job.data, this->combobox_serial_ports->currentText());
+        interrupted |= journal.load() && !journal.is_empty();
+    }
+
+    // offer to continue a previously interrupted job of the same image(s)
+    if(interrupted) {
+        auto answer = QMessageBox::question(this, tr("Resume flash"),
+                                            tr("A previous attempt to flash these images was interrupted. "
+                                               "Do you want to resume where it stopped?"));
+        this->flashthread->set_resume(answer == QMessageBox::Yes);
+    }
+
+    this->progress_bar_load->setMaximum(this->flashthread->get_nr_blocks());
+    this->flashthread->set_deadline(FLASH_DEADLINE + FLASH_DEADLINE_PER_BLOCK * this->flashthread->get_nr_blocks());
+
+    connect(this->flashthread.get(), SIGNAL(flash_result_ready()), this, SLOT(flash_result_ready()));
+    connect(this->flashthread.get(), SIGNAL(flash_interrupted(const QString&)), this, SLOT(flash_interrupted(const QString&)));
+    connect(this->flashthread.get(), SIGNAL(flash_plan_ready(uint,uint,double)), this, SLOT(flash_plan_ready(uint,uint,double)));
+    connect(this->flashthread.get(), SIGNAL(flash_job_start(uint,uint)), this, SLOT(flash_job_start(uint,uint)));
+    connect(this->flashthread.get(), SIGNAL(flash_chip_id_error(uint)), this, SLOT(flash_chip_id_error(uint)));
+    this->serial_interface->move_to_thread(this->flashthread.get());
+    this->flashthread->start();
+    this->progress_operation = "Flashing";
+    this->progress_monitor.start(this->flashthread.get());
+
+    // disable all buttons
+    this->disable_all_buttons();
 }
 
-/*
- * @brief Response that the chip id could not be verified
+/**
+ * @brief Slot to accept the planned number of erases and burns
  */
-void SerialWidget::flash_chip_id_error(unsigned int chip_id) {
-    QMessageBox msg_box;
-    msg_box.setIcon(QMessageBox::Warning);
-    msg_box.setText(tr("The chip id (%1) does not match the proper value for a SST39SF0x0 chip. Please verify that you inserted"
-                       " and/or selected the right FLASH cartridge. If so, resocket the cartridge and try again.").arg(chip_id,0,16));
-    msg_box.setWindowIcon(QIcon(":/assets/img/logo.ico"));
-    msg_box.exec();
+void SerialWidget::flash_plan_ready(unsigned int nr_erases, unsigned int nr_burns, double seconds) {
+    qInfo() << "Flash plan:" << nr_erases << "erases and" << nr_burns << "block burns.";
+    this->signal_emit_statusbar_message(QString("Flashing: %1 erases, %2 block burns, expected %3 seconds.").arg(nr_erases).arg(nr_burns).arg(seconds, 0, 'f', 1));
+}
 
-    // reset flash button
-    this->progress_bar_load->setEnabled(true);
-    this->enable_all_buttons();
+/**
+ * @brief Slot to toggle between $FF and $00 padding
+ */
+void SerialWidget::set_pad_blank(bool pad_blank) {
+    this->padding_byte = pad_blank ? 0xFF : 0x00;
 }
 
 /**
- * @brief Slot to accept when a sector is about to be verified
+ * @brief Slot to indicate that flashing of a slot starts
  */
-void SerialWidget::verify_block_start(unsigned int sector_id) {
-    this->progress_bar_load->setValue(sector_id);
+void SerialWidget::flash_job_start(unsigned int job_id, unsigned int slot_id) {
+    qInfo() << "Flashing job" << job_id + 1 << "to slot" << slot_id + 1;
+    this->flash_slot_id = slot_id;
+    this->progress_operation = QString("Flashing slot %1,").arg(slot_id + 1);
 }
 
 /**
- * @brief Slot to accept when a sector is verified
+ * @brief Slot to accept the sampled progress of the running operation
  */
-void SerialWidget::verify_block_done(unsigned int sector_id) {
-    double seconds_passed = (double)this->timer1.elapsed() / 1000.0;
-    double seconds_per_sector = seconds_passed / (double)(sector_id+1);
-    double seconds_remaining = seconds_per_sector * (this->num_blocks - sector_id - 1);
-    if(sector_id < (this->num_blocks - 1)) {
-        this->signal_emit_statusbar_message(QString("%1 sector %2 / %3 : %4 seconds remaining.").arg("Verifying ").arg(sector_id+1).arg(this->num_blocks).arg(seconds_remaining));
+void SerialWidget::update_progress(unsigned int nr_blocks_done, unsigned int nr_blocks_total, double seconds_remaining) {
+    // the total is unknown until e.g. the chip has been identified
+    if(nr_blocks_total == 0) {
+        return;
+    }
+
+    this->progress_bar_load->setMaximum(nr_blocks_total);
+    this->progress_bar_load->setValue(nr_blocks_done);
+    if(nr_blocks_done < nr_blocks_total && seconds_remaining >= 0.0) {
+        const double kb_per_second = this->progress_monitor.get_rate() * ChipDescriptor::BLOCK_SIZE / 1024.0;
+        this->signal_emit_statusbar_message(QString("%1 block %2 / %3 : %4 seconds remaining (%5 kB/s).")
+                                            .arg(this->progress_operation).arg(nr_blocks_done).arg(nr_blocks_total)
+                                            .arg(seconds_remaining, 0, 'f', 0).arg(kb_per_second, 0, 'f', 1));
     }
-    this->progress_bar_load->setValue(sector_id+1);
 }
 
 /*
- * @brief Signal that a verified operation is finished
+ * @brief Signal that a flash operation is finished
+ *
+ * Every burned block has been read back and verified by the flash thread,
+ * and all blocks that were not burned have been read back in a single batch
+ * afterwards, such that the complete image is verified.
  */
-void SerialWidget::verify_result_ready() {
-    this->progress_bar_load->setValue(this->num_blocks);
-    QByteArray verify_data = this->readerthread->get_data();
-    this->readerthread.reset(); // delete object
+void SerialWidget::flash_result_ready() {
+    this->progress_monitor.stop();
+    this->progress_bar_load->setValue(this->progress_bar_load->maximum());
+    const auto failed_blocks = this->flashthread->get_failed_blocks();
 
-    if(verify_data == this->flash_data) {
-        this->signal_emit_statusbar_message("Ready - Done verification in " + QString::number((double)this->timer1.elapsed() / 1000) + " seconds.");
-        this->data = this->flash_data;
-        emit(signal_data_read());
+    if(failed_blocks.empty()) {
+        this->signal_emit_statusbar_message("Ready - Done flashing and verification in " + QString::number((double)this->timer1.elapsed() / 1000) + " seconds.");
+        for(const auto& job : this->flashthread->get_jobs()) {
+            for(int offset=0; offset<job.data.size(); offset+=ChipDescriptor::SLOT_SIZE) {
+                this->slot_cache[job.slot_id + offset / ChipDescriptor::SLOT_SIZE] = job.data.mid(offset, ChipDescriptor::SLOT_SIZE);
+            }
+        }
+        if(this->flashthread->get_jobs().size() == 1) {
+            this->data = this->flash_data;
+            emit(signal_data_read());
+        }
         QMessageBox msg_box(QMessageBox::Information,
                 "Flash complete",
                 "Cartridge was successfully flashed. Data integrity verified.",
@@ -328,15 +724,54 @@ void SerialWidget::verify_result_ready() {
         msg_box.setWindowFlags(Qt::Dialog | Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint);
         msg_box.exec();
     } else {
+        QStringList blocks;
+        for(const auto& failed : failed_blocks) {
+            blocks.append(QString("%1:$%2").arg(failed.first + 1).arg(failed.second * ChipDescriptor::BLOCK_SIZE, 4, 16, QChar('0')).toUpper());
+        }
         QMessageBox msg_box(QMessageBox::Critical,
                 "Error",
-                "Data integrity could not be verified. Please try to reflash the cartridge. It might help to resocket the flash cartridge.",
+                tr("Data integrity could not be verified for the blocks at (slot:address) %1. Please try to reflash the cartridge. "
+                   "It might help to resocket the flash cartridge.").arg(blocks.join(", ")),
                 QMessageBox::Ok, this);
         msg_box.setWindowFlags(Qt::Dialog | Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint);
         msg_box.exec();
     }
 
-    // re-enable all buttons when data is read
+    // re-enable all buttons when flashing is done
+    this->enable_all_buttons();
+}
+
+/*
+ * @brief Signal that a flash operation was aborted by an error
+ */
+void SerialWidget::flash_interrupted(const QString& error_msg) {
+    this->progress_monitor.stop();
+    this->signal_emit_statusbar_message("Flashing interrupted.");
+    QMessageBox msg_box(QMessageBox::Critical,
+            "Error",
+            tr("Flashing was interrupted: %1\n\nReconnect the cartridge reader and flash the same image "
+               "to the same slot to resume the operation.").arg(error_msg),
+            QMessageBox::Ok, this);
+    msg_box.setWindowFlags(Qt::Dialog | Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint);
+    msg_box.exec();
+
+    this->enable_all_buttons();
+}
+
+/*
+ * @brief Response that the chip id could not be verified
+ */
+void SerialWidget::flash_chip_id_error(unsigned int chip_id) {
+    this->progress_monitor.stop();
+    QMessageBox msg_box;
+    msg_box.setIcon(QMessageBox::Warning);
+    msg_box.setText(tr("The chip id (%1) does not match the proper value for a SST39SF0x0 chip. Please verify that you inserted"
+                       " and/or selected the right FLASH cartridge. If so, resocket the cartridge and try again.").arg(chip_id,0,16));
+    msg_box.setWindowIcon(QIcon(":/assets/img/logo.ico"));
+    msg_box.exec();
+
+    // reset flash button
+    this->progress_bar_load->setEnabled(true);
     this->enable_all_buttons();
 }
 
@@ -384,10 +819,48 @@ void SerialWidget::build_data_interface(QVBoxLayout* target_layout) {
     this->button_write_cartridge = new QPushButton(tr("Write to cartridge"));
     data_layout->addWidget(this->button_write_cartridge, 0, 1);
     this->button_write_cartridge->setEnabled(false);
+    this->button_dump_chip = new QPushButton(tr("Dump full chip to file"));
+    data_layout->addWidget(this->button_dump_chip, 1, 0);
+    this->button_dump_chip->setEnabled(false);
+    this->button_batch_flash = new QPushButton(tr("Write files to slots"));
+    this->button_batch_flash->setToolTip(tr("Write several files to consecutive slots in a single session."));
+    data_layout->addWidget(this->button_batch_flash, 1, 1);
+    this->button_batch_flash->setEnabled(false);
+    this->checkbox_differential = new QCheckBox(tr("Only flash changed sectors"));
+    this->checkbox_differential->setChecked(true);
+    this->checkbox_differential->setToolTip(tr("Compare against the slot contents read or written in this session (or read the slot first) "
+                                               "and only erase and burn sectors that differ. Re-select the port after swapping cartridges."));
+    data_layout->addWidget(this->checkbox_differential, 2, 0, 1, 2);
+    this->checkbox_pad_blank = new QCheckBox(tr("Pad with $FF (blank flash)"));
+    this->checkbox_pad_blank->setChecked(this->padding_byte == 0xFF);
+    this->checkbox_pad_blank->setToolTip(tr("Pad the last block with $FF instead of $00. Blank blocks are not transferred to the cartridge."));
+    data_layout->addWidget(this->checkbox_pad_blank, 3, 0, 1, 2);
+    connect(this->checkbox_pad_blank, SIGNAL(toggled(bool)), this, SLOT(set_pad_blank(bool)));
+    this->checkbox_slot_cache = new QCheckBox(tr("Serve reads from the slot cache"));
+    this->checkbox_slot_cache->setChecked(false);
+    this->checkbox_slot_cache->setToolTip(tr("Serve slots read before from the on-disk cache. A slot is recognized by a few sampled blocks only, "
+                                             "such that a slot that was changed elsewhere (e.g. with the TL866) may be reported with its old contents."));
+    data_layout->addWidget(this->checkbox_slot_cache, 4, 0, 1, 2);
+
+    this->button_flash_all_readers = new QPushButton(tr("Write to all readers"));
+    this->button_flash_all_readers->setToolTip(tr("Write the data to the cartridges in all detected readers simultaneously."));
+    data_layout->addWidget(this->button_flash_all_readers, 5, 0, 1, 2);
+    this->button_flash_all_readers->setEnabled(false);
 
     // build progress indicator
     this->progress_bar_load = new QProgressBar();
-    data_layout->addWidget(this->progress_bar_load, 2, 0, 1, 2);
+    data_layout->addWidget(this->progress_bar_load, 6, 0);
+    this->button_cancel = new QPushButton(tr("Cancel"));
+    this->button_cancel->setToolTip(tr("Stop the running operation after the current command. An interrupted flash can be resumed."));
+    data_layout->addWidget(this->button_cancel, 6, 1);
+    this->button_cancel->setEnabled(false);
+
+    // progress per reader when flashing with multiple readers
+    this->device_container = new QGroupBox("Cartridge readers");
+    this->layout_devices = new QGridLayout();
+    this->device_container->setLayout(this->layout_devices);
+    this->device_container->setVisible(false);
+    target_layout->addWidget(this->device_container);
 }
 
 /**
@@ -398,6 +871,10 @@ void SerialWidget::disable_all_buttons() {
     this->button_scan_ports->setEnabled(false);
     this->button_read_cartridge->setEnabled(false);
     this->button_write_cartridge->setEnabled(false);
+    this->button_dump_chip->setEnabled(false);
+    this->button_batch_flash->setEnabled(false);
+    this->button_flash_all_readers->setEnabled(false);
+    this->button_cancel->setEnabled(true);
 }
 
 /**
@@ -408,4 +885,8 @@ void SerialWidget::enable_all_buttons() {
     this->button_scan_ports->setEnabled(true);
     this->button_read_cartridge->setEnabled(true);
     this->button_write_cartridge->setEnabled(true);
+    this->button_dump_chip->setEnabled(true);
+    this->button_batch_flash->setEnabled(true);
+    this->button_flash_all_readers->setEnabled(this->combobox_serial_ports->count() > 1);
+    this->button_cancel->setEnabled(false);
 }
@@ -13,10 +13,17 @@
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QElapsedTimer>
+#include <QTimer>
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QInputDialog>
 
 #include "serial_interface.h"
 #include "readthread.h"
 #include "flashthread.h"
+#include "flashscheduler.h"
+#include "dumpthread.h"
+#include "progressmonitor.h"
 #include "dialogslotselection.h"
 
 class SerialWidget : public QWidget
@@ -33,22 +40,55 @@ private:
 
     QPushButton* button_read_cartridge;
     QPushButton* button_write_cartridge;
+    QPushButton* button_dump_chip;
+    QPushButton* button_batch_flash;
+    QPushButton* button_flash_all_readers;
+    QPushButton* button_cancel;
+    QCheckBox* checkbox_differential;
+    QCheckBox* checkbox_slot_cache;
+    QCheckBox* checkbox_pad_blank;
     QProgressBar* progress_bar_load;
 
+    QGroupBox* device_container;
+    QGridLayout* layout_devices;
+    std::vector<QLabel*> device_labels;
+    std::vector<QProgressBar*> device_progress_bars;
+
     QComboBox* combobox_serial_ports;
     std::vector<std::pair<uint16_t, uint16_t>> port_identifiers;
     std::unique_ptr<ReadThread> readerthread;
     std::unique_ptr<FlashThread> flashthread;
+    std::unique_ptr<DumpThread> dumpthread;
+    std::unique_ptr<FlashScheduler> flashscheduler;
     std::shared_ptr<SerialInterface> serial_interface;
 
     QByteArray data;            // rom data
     QByteArray flash_data;      // data to be flashed
-    unsigned int num_blocks;    // number of blocks to read
+    uint8_t padding_byte = 0xFF;    // byte to pad the last block with
+    unsigned int flash_slot_id = 0; // slot that is currently flashed
+
+    // last known contents per slot of the cartridge in the selected reader
+    std::unordered_map<int, QByteArray> slot_cache;
 
     // time operations
     QElapsedTimer timer1;
     QElapsedTimer timer2;
 
+    // samples the progress of the running worker thread
+    ProgressMonitor progress_monitor;
+    QString progress_operation;     // description of the running operation
+
+    // periodically checks the session with the cartridge reader
+    static const int KEEPALIVE_INTERVAL = 2000;
+    QTimer keepalive_timer;
+    bool in_keepalive = false;      // keepalive is waiting for the board in a local event loop
+
+    // deadlines (ms) after which operations are cancelled
+    static const int READ_DEADLINE = 60000;
+    static const int DUMP_DEADLINE = 600000;
+    static const int FLASH_DEADLINE = 30000;
+    static const int FLASH_DEADLINE_PER_BLOCK = 500;
+
 public:
     explicit SerialWidget(QWidget *parent = nullptr);
 
@@ -60,6 +100,16 @@ public:
         return this->data;
     }
 
+    /**
+     * @brief Set the byte used to pad the flash data to a full block
+     * @param _padding_byte padding byte; 0xFF matches erased flash and
+     *        is not transferred to the cartridge
+     */
+    void set_padding_byte(uint8_t _padding_byte) {
+        this->checkbox_pad_blank->setChecked(_padding_byte == 0xFF);
+        this->padding_byte = _padding_byte;
+    }
+
     /**
      * @brief Set flash data
      * @param _data
@@ -77,6 +127,30 @@ private:
 
     void enable_all_buttons();
 
+    /**
+     * @brief Whether an operation on a cartridge reader is in progress
+     */
+    bool is_busy() const;
+
+    /**
+     * @brief Check whether the keepalive currently uses the port, such that no operation can be started
+     * @return whether the keepalive is in progress
+     */
+    bool is_keepalive_running();
+
+    /**
+     * @brief Pad data to full blocks
+     * @param data data to be flashed
+     * @return padded data
+     */
+    QByteArray pad_flash_data(const QByteArray& data) const;
+
+    /**
+     * @brief Launch a flash thread for one or more slots
+     * @param jobs slots and their data
+     */
+    void start_flash(const std::vector<FlashJob>& jobs);
+
 private slots:
     /****************************************************************************
      *  SIGNALS :: COMMUNICATION INTERFACE ROUTINES
@@ -92,6 +166,11 @@ private slots:
      */
     void select_com_port();
 
+    /**
+     * @brief Check in between operations that the cartridge reader still responds
+     */
+    void keepalive();
+
     /****************************************************************************
      *  SIGNALS :: READ ROM ROUTINES
      ****************************************************************************/
@@ -101,20 +180,44 @@ private slots:
      */
     void read_cartridge();
 
+    /*
+     * @brief Signal that a read operation is finished
+     */
+    void read_result_ready();
+
+    /*
+     * @brief Signal that a read operation was aborted
+     */
+    void read_error(const QString& error_msg);
+
     /**
-     * @brief Slot to indicate that a sector is about to be read / written
+     * @brief Cancel the running operation
      */
-    void read_block_start(unsigned int sector_id);
+    void cancel_operation();
+
+    /****************************************************************************
+     *  SIGNALS :: DUMP CHIP
+     ****************************************************************************/
 
     /**
-     * @brief Slot to accept that a sector is read / written
+     * @brief Dump the complete chip to a file
      */
-    void read_block_done(unsigned int sector_id);
+    void dump_chip();
 
-    /*
-     * @brief Signal that a read operation is finished
+    /**
+     * @brief Slot to accept that the chip is identified and dumping starts
      */
-    void read_result_ready();
+    void dump_started(unsigned int nr_blocks);
+
+    /**
+     * @brief Signal that a dump operation is finished
+     */
+    void dump_result_ready();
+
+    /**
+     * @brief Signal that a dump operation has failed
+     */
+    void dump_error(const QString& message);
 
     /****************************************************************************
      *  SIGNALS :: FLASH ROM
@@ -126,39 +229,69 @@ private slots:
     void flash_rom();
 
     /**
-     * @brief Slot to indicate that a page is about to be written
+     * @brief Put several files on consecutive slots of the flash cartridge
      */
-    void flash_block_start(unsigned int page_id);
+    void flash_batch();
 
     /**
-     * @brief Slot to accept that a page is written
+     * @brief Put the current data on the cartridges in all detected readers
      */
-    void flash_block_done(unsigned int page_id);
+    void flash_all_readers();
 
-    /*
-     * @brief Signal that a flash operation is finished
+    /**
+     * @brief Slot to accept that a reader starts flashing a cartridge
      */
-    void flash_result_ready();
+    void scheduler_job_started(unsigned int device_id, unsigned int job_id);
+
+    /**
+     * @brief Slot to accept the progress of a reader
+     */
+    void scheduler_device_progress(unsigned int device_id, unsigned int nr_blocks_done, unsigned int nr_blocks);
+
+    /**
+     * @brief Slot to accept that a reader has finished a cartridge
+     */
+    void scheduler_job_finished(unsigned int device_id, unsigned int job_id, bool success, const QString& message, bool hold);
+
+    /**
+     * @brief Slot to accept that all cartridges are flashed
+     */
+    void scheduler_finished(unsigned int nr_success, unsigned int nr_failed);
+
+    /**
+     * @brief Slot to indicate that flashing of a slot starts
+     */
+    void flash_job_start(unsigned int job_id, unsigned int slot_id);
+
+    /**
+     * @brief Slot to toggle between $FF and $00 padding
+     */
+    void set_pad_blank(bool pad_blank);
+
+    /**
+     * @brief Slot to accept the sampled progress of the running operation
+     */
+    void update_progress(unsigned int nr_blocks_done, unsigned int nr_blocks_total, double seconds_remaining);
 
     /*
      * @brief Signal that a flash operation is finished
      */
-    void flash_chip_id_error(unsigned int chip_id);
+    void flash_result_ready();
 
-    /**
-     * @brief Slot to accept when a sector is about to be verified
+    /*
+     * @brief Signal that a flash operation was aborted by an error
      */
-    void verify_block_start(unsigned int page_id);
+    void flash_interrupted(const QString& error_msg);
 
     /**
-     * @brief Slot to accept when a sector is verified
+     * @brief Slot to accept the planned number of erases and burns
      */
-    void verify_block_done(unsigned int page_id);
+    void flash_plan_ready(unsigned int nr_erases, unsigned int nr_burns, double seconds);
 
     /*
-     * @brief Signal that a verified operation is finished
+     * @brief Signal that a flash operation is finished
      */
-    void verify_result_ready();
+    void flash_chip_id_error(unsigned int chip_id);
 
 signals:
     void signal_emit_statusbar_message(const QString& str);
@@ -0,0 +1,201 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "slotcache.h"
+
+// serializes access of the worker threads to the files of the cache
+static QMutex slotcache_mutex;
+
+/**
+ * @brief Constructor, the cache resides in the application data folder
+ */
+SlotCache::SlotCache() :
+    directory(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/slotcache")
+{}
+
+/**
+ * @brief Get the blocks that are sampled to establish the fingerprint
+ * @return block ids relative to the slot
+ */
+std::vector<unsigned int> SlotCache::get_sample_blocks() {
+    // spread the samples evenly over the slot, including its first and last block
+    const unsigned int nr_blocks = ChipDescriptor::get_blocks_per_slot();
+    std::vector<unsigned int> blocks;
+    for(unsigned int i=0; i<NR_SAMPLES; i++) {
+        blocks.push_back(i * (nr_blocks - 1) / (NR_SAMPLES - 1));
+    }
+    return blocks;
+}
+
+/**
+ * @brief Get the fingerprint of a slot
+ * @param chip_id chip id
+ * @param samples data of the sample blocks
+ * @return fingerprint (hex)
+ */
+QByteArray SlotCache::get_fingerprint(unsigned int chip_id, const QByteArray& samples) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QString("%1").arg(chip_id, 4, 16, QChar('0')).toUpper().toLatin1());
+    hash.addData(samples);
+    return hash.result().toHex();
+}
+
+/**
+ * @brief Get the fingerprint of a complete slot image
+ * @param chip_id chip id
+ * @param image slot image
+ * @return fingerprint (hex)
+ */
+QByteArray SlotCache::get_image_fingerprint(unsigned int chip_id, const QByteArray& image) {
+    QByteArray samples;
+    for(unsigned int block_id : get_sample_blocks()) {
+        samples.append(image.mid(block_id * ChipDescriptor::BLOCK_SIZE, ChipDescriptor::BLOCK_SIZE));
+    }
+    return get_fingerprint(chip_id, samples);
+}
+
+/**
+ * @brief Find the image of a slot
+ * @param fingerprint fingerprint of the slot
+ * @return slot image, empty when not in the cache
+ */
+QByteArray SlotCache::lookup(const QByteArray& fingerprint) {
+    QMutexLocker locker(&slotcache_mutex);
+
+    QJsonObject index = this->load_index();
+    const QString key(fingerprint);
+    if(!index.contains(key)) {
+        return QByteArray();
+    }
+
+    // the name of the image file is its hash, which guards against corrupt files
+    QJsonObject entry = index[key].toObject();
+    const QString image_hash = entry["image"].toString();
+    QFile infile(this->get_image_filename(image_hash));
+    QByteArray image;
+    if(infile.open(QIODevice::ReadOnly)) {
+        image = infile.readAll();
+    }
+    if(image.size() != (int)ChipDescriptor::SLOT_SIZE ||
+       QString(QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex()) != image_hash) {
+        qWarning() << "Discarding invalid slot cache entry " << key;
+        index.remove(key);
+        this->save_index(index);
+        return QByteArray();
+    }
+
+    entry["used"] = QDateTime::currentMSecsSinceEpoch();
+    index[key] = entry;
+    this->save_index(index);
+
+    return image;
+}
+
+/**
+ * @brief Store the image of a slot
+ * @param chip_id chip id
+ * @param image complete slot image
+ */
+void SlotCache::store(unsigned int chip_id, const QByteArray& image) {
+    if(image.size() != (int)ChipDescriptor::SLOT_SIZE) {
+        return;
+    }
+
+    QMutexLocker locker(&slotcache_mutex);
+    QDir().mkpath(this->directory);
+
+    const QString image_hash(QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex());
+    if(!QFile::exists(this->get_image_filename(image_hash))) {
+        QSaveFile outfile(this->get_image_filename(image_hash));
+        if(!(outfile.open(QIODevice::WriteOnly) && outfile.write(image) == image.size() && outfile.commit())) {
+            qCritical() << "Could not write slot cache image " << this->get_image_filename(image_hash);
+            return;
+        }
+    }
+
+    QJsonObject entry;
+    entry["image"] = image_hash;
+    entry["used"] = QDateTime::currentMSecsSinceEpoch();
+    QJsonObject index = this->load_index();
+    index[QString(get_image_fingerprint(chip_id, image))] = entry;
+
+    // evict the least recently used fingerprints
+    while(index.size() > MAX_ENTRIES) {
+        QString oldest;
+        qint64 oldest_used = 0;
+        for(auto it = index.begin(); it != index.end(); ++it) {
+            const qint64 used = (qint64)it.value().toObject()["used"].toDouble();
+            if(oldest.isEmpty() || used < oldest_used) {
+                oldest = it.key();
+                oldest_used = used;
+            }
+        }
+        index.remove(oldest);
+    }
+
+    // remove the images that are no longer referenced
+    QStringList images;
+    for(auto it = index.begin(); it != index.end(); ++it) {
+        images.append(it.value().toObject()["image"].toString());
+    }
+    for(const QString& filename : QDir(this->directory).entryList({"*.bin"}, QDir::Files)) {
+        if(!images.contains(QFileInfo(filename).completeBaseName())) {
+            QFile::remove(this->directory + "/" + filename);
+        }
+    }
+
+    this->save_index(index);
+}
+
+/**
+ * @brief Load the index mapping fingerprints to images
+ */
+QJsonObject SlotCache::load_index() const {
+    QFile infile(this->directory + "/index.json");
+    if(!infile.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+
+    return QJsonDocument::fromJson(infile.readAll()).object();
+}
+
+/**
+ * @brief Store the index mapping fingerprints to images
+ */
+void SlotCache::save_index(const QJsonObject& index) const {
+    QDir().mkpath(this->directory);
+
+    // write atomically such that an interruption never leaves a corrupt index
+    QSaveFile outfile(this->directory + "/index.json");
+    if(outfile.open(QIODevice::WriteOnly)) {
+        outfile.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+        outfile.commit();
+    } else {
+        qCritical() << "Could not write slot cache index " << outfile.fileName();
+    }
+}
+
+/**
+ * @brief Path of the file holding an image
+ * @param image_hash SHA-256 of the image (hex)
+ */
+QString SlotCache::get_image_filename(const QString& image_hash) const {
+    return this->directory + "/" + image_hash + ".bin";
+}
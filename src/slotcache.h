@@ -0,0 +1,125 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef SLOTCACHE_H
+#define SLOTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <vector>
+
+#include "chipdescriptor.h"
+
+/**
+ * @brief On-disk cache of slot images, addressed by a fingerprint of the slot
+ *
+ * The fingerprint of a slot is the hash of the chip id and a small set of
+ * sampled blocks, such that it can be established over serial at a fraction
+ * of the cost of reading the complete slot. The images themselves are stored
+ * by their SHA-256, such that identical slots share a single file.
+ *
+ * Note that blocks outside the sample are not compared: a slot that only
+ * differs from a cached image in unsampled blocks is served from the cache.
+ *
+ * The cache can be accessed from several worker threads at once.
+ */
+class SlotCache {
+
+private:
+    QString directory;                  // folder holding the index and the images
+
+    static const unsigned int NR_SAMPLES = 8;       // number of sampled blocks per slot
+    static const int MAX_ENTRIES = 256;             // number of fingerprints that are kept
+
+public:
+    /**
+     * @brief Constructor, the cache resides in the application data folder
+     */
+    SlotCache();
+
+    /**
+     * @brief Get the blocks that are sampled to establish the fingerprint
+     * @return block ids relative to the slot
+     */
+    static std::vector<unsigned int> get_sample_blocks();
+
+    /**
+     * @brief Get the fingerprint of a slot
+     * @param chip_id chip id
+     * @param samples data of the sample blocks
+     * @return fingerprint (hex)
+     */
+    static QByteArray get_fingerprint(unsigned int chip_id, const QByteArray& samples);
+
+    /**
+     * @brief Get the fingerprint of a complete slot image
+     * @param chip_id chip id
+     * @param image slot image
+     * @return fingerprint (hex)
+     */
+    static QByteArray get_image_fingerprint(unsigned int chip_id, const QByteArray& image);
+
+    /**
+     * @brief Find the image of a slot
+     * @param fingerprint fingerprint of the slot
+     * @return slot image, empty when not in the cache
+     */
+    QByteArray lookup(const QByteArray& fingerprint);
+
+    /**
+     * @brief Store the image of a slot
+     * @param chip_id chip id
+     * @param image complete slot image
+     */
+    void store(unsigned int chip_id, const QByteArray& image);
+
+private:
+    /**
+     * @brief Load the index mapping fingerprints to images
+     */
+    QJsonObject load_index() const;
+
+    /**
+     * @brief Store the index mapping fingerprints to images
+     */
+    void save_index(const QJsonObject& index) const;
+
+    /**
+     * @brief Path of the file holding an image
+     * @param image_hash SHA-256 of the image (hex)
+     */
+    QString get_image_filename(const QString& image_hash) const;
+};
+
+#endif // SLOTCACHE_H
@@ -5,10 +5,15 @@ ThreadTL866::ThreadTL866(QObject *parent) : QThread(parent) {
 }
 
 void ThreadTL866::run() {
+    if(this->operation == 1 || this->operation == 2) {
+        this->plan_write();
+    }
+
     this->process = this->build_process();
 
     this->process->setProcessChannelMode(QProcess::MergedChannels); // combine error and standard output
-    connect(this->process, SIGNAL(readyReadStandardOutput()), this, SLOT(slot_parse_output()));
+    // parse the output in this thread as it arrives; only progress changes are signalled to the GUI
+    connect(this->process, SIGNAL(readyReadStandardOutput()), this, SLOT(slot_parse_output()), Qt::DirectConnection);
 
     this->process->start();
     qDebug() << "TL866 process launched";
@@ -23,7 +28,11 @@ void ThreadTL866::run() {
 
         if(this->process->exitCode() != 0) {
             qCritical("TL866 process gave an error, see output log.");
-        } else if(this->operation == 0) {
+        } else {
+            this->success = true;
+        }
+
+        if(this->success && (this->operation == 0 || this->operation == 3)) {
             qDebug() << "Try reading output file.";
             QFile mcodefile(process->workingDirectory() + "/read.bin");
             if(mcodefile.exists() && mcodefile.open(QIODevice::ReadOnly)) {
@@ -32,6 +41,11 @@ void ThreadTL866::run() {
                 throw std::runtime_error("Could not read data file.");
             }
         }
+
+        if(this->success && this->operation == 3) {
+            this->mismatches = this->manifest.verify(this->data);
+            qInfo() << "Verification found" << this->mismatches.size() << "deviating slots.";
+        }
     } else {
         qCritical() << "Run process did not launch";
         qCritical() << this->process->errorString();
@@ -48,8 +62,12 @@ void ThreadTL866::run() {
             emit(signal_read_done(this));
         break;
         case 1:
+        case 2:
             emit(signal_write_done(this));
         break;
+        case 3:
+            emit(signal_verify_done(this));
+        break;
         default:
             throw std::logic_error("Invalid operation.");
         break;
@@ -61,10 +79,10 @@ QProcess* ThreadTL866::build_process() {
     qDebug() << tr("Created temporary path: ") << cwd;
     QStringList arguments = {"-p", "SST39SF040@PLCC32"};
 
-    if(this->operation == 0) { // read
+    if(this->operation == 0 || this->operation == 3) { // read
         arguments.append({"-r", "read.bin"});
-    } else if(this->operation == 1) { // write
-        arguments.append({"-w", "write.bin", "-s"});
+    } else if(this->operation == 1 || this->operation == 2) { // write
+        arguments.append(this->write_arguments);
     } else {
         throw std::logic_error("Unknown operation.");
     }
@@ -75,11 +93,11 @@ QProcess* ThreadTL866::build_process() {
     flash_process->setProcessChannelMode(QProcess::SeparateChannels);
     flash_process->setWorkingDirectory(cwd);
 
-    if(this->operation == 1) { // write operation
+    if(this->operation == 1 || this->operation == 2) { // write operation
         // write binary file
         QFile outfile(cwd + "/write.bin");
         if(outfile.open(QIODevice::WriteOnly)) {
-            outfile.write(this->data);
+            outfile.write(this->write_data);
         }
         outfile.close();
     }
@@ -87,6 +105,79 @@ QProcess* ThreadTL866::build_process() {
     return flash_process;
 }
 
+/**
+ * @brief Determine which part of the image is handed to minipro
+ *
+ * Minipro can only erase the complete chip and always programs from address
+ * zero onwards, so a partial write is expressed as a prefix of the image. When
+ * all changed bits go from 1 to 0, the chip is not erased and the prefix ends
+ * at the last changed sector. Otherwise the chip is erased and the prefix ends
+ * at the last sector holding non-blank data. Prefixes are rounded up to whole
+ * sectors.
+ *
+ * Past the prefix, an erased chip reads as 0xFF, whereas a chip that is not
+ * erased keeps its previous contents. The resulting contents of the chip are
+ * recorded in written_data accordingly.
+ *
+ * When the reference already holds the image, the chip is only verified
+ * against the image, as the chip in the socket may have been swapped since
+ * the reference was obtained.
+ */
+void ThreadTL866::plan_write() {
+    this->write_data = this->data;
+    this->write_arguments = QStringList({"-w", "write.bin", "-s"});
+    this->written_data = this->data;
+    this->written_data.append(QByteArray(std::max(0, (int)CHIP_SIZE - this->data.size()), (char)0xFF));
+
+    if(this->operation != 2 || this->reference.size() < this->data.size()) {
+        return;
+    }
+
+    // pad image to whole sectors, unprogrammed bytes read as 0xFF
+    QByteArray target = this->data;
+    const unsigned int nr_sectors = (target.size() + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    target.append(QByteArray(nr_sectors * SECTOR_SIZE - target.size(), (char)0xFF));
+    QByteArray current = this->reference.left(target.size());
+    current.append(QByteArray(target.size() - current.size(), (char)0xFF));
+
+    const FlashPlanner planner(current, target, SECTOR_SIZE);
+    unsigned int end = 0;
+    bool erase = false;
+    for(const auto& sector : planner.get_sectors()) {
+        if(sector.action != FlashPlanner::SectorAction::UNCHANGED) {
+            end = (sector.first_block + sector.nr_blocks) * FlashPlanner::BLOCK_SIZE;
+        }
+        erase |= sector.action == FlashPlanner::SectorAction::ERASE_PROGRAM;
+    }
+
+    if(end == 0) {
+        qInfo() << "Reference already holds the image, verifying the chip.";
+        this->write_data = target;
+        this->write_arguments = QStringList({"-m", "write.bin", "-s"});
+        this->written_data = this->reference;
+        return;
+    }
+
+    if(erase) {
+        // after a chip erase every non-blank sector has to be programmed again
+        for(unsigned int i=0; i<nr_sectors; i++) {
+            if(!FlashPlanner::is_blank(target.mid(i * SECTOR_SIZE, SECTOR_SIZE))) {
+                end = (i + 1) * SECTOR_SIZE;
+            }
+        }
+        end = std::max(end, SECTOR_SIZE);
+    } else {
+        this->write_arguments.append("-e"); // do not erase the chip
+    }
+
+    this->write_data = target.left(end);
+    if(!erase) {
+        this->written_data = this->write_data + this->reference.mid(end);
+    }
+    qInfo() << "Writing" << end / SECTOR_SIZE << "of" << CHIP_SIZE / SECTOR_SIZE << "sectors"
+            << (erase ? "after a chip erase." : "without erasing.");
+}
+
 QString ThreadTL866::build_run_directory() {
     qDebug() << "Building run directory";
     QTemporaryDir dir;
@@ -115,19 +206,10 @@ QString ThreadTL866::build_run_directory() {
 }
 
 void ThreadTL866::slot_parse_output() {
-    const QRegularExpression regex(QStringLiteral("([0-9]+\\%)"));
     int numbytes = this->process->bytesAvailable();
     if(numbytes > 0) {
-        QByteArray data = this->process->read(numbytes);
-        this->output.append(data);
-
-        auto match_iterator = regex.globalMatch(this->output);
-        while(match_iterator.hasNext()) {
-            auto result = match_iterator.next();
-            if(!match_iterator.hasNext()) {
-                int perc = result.captured(0).remove("%").toInt();
-                emit(this->signal_progress(perc));
-            }
+        if(this->output_parser.feed(this->process->read(numbytes))) {
+            emit(this->signal_progress(this->output_parser.get_progress()));
         }
     }
 }
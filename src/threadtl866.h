@@ -11,17 +11,31 @@
 #include <QProcess>
 #include <QRegularExpression>
 
+#include "flashplanner.h"
+#include "image_manifest.h"
+#include "tl866_output_parser.h"
+
 class ThreadTL866 : public QThread
 {
     Q_OBJECT
 
 private:
-    int operation = -1; // -1 unset, 0 read, 1 write
+    int operation = -1; // -1 unset, 0 read, 1 write, 2 write changes only, 3 verify
     QByteArray data;
-    QByteArray output;
+    QByteArray reference;           // last known contents of the chip, used for writing changes only
+    QByteArray write_data;          // (prefix of the) image that is passed to minipro
+    QByteArray written_data;        // contents of the chip after a successful write
+    QStringList write_arguments;    // minipro arguments of the write
+    bool success = false;
+    ImageManifest manifest;         // expected contents of the chip, used for verification
+    std::vector<ImageManifest::Mismatch> mismatches;
+    TL866OutputParser output_parser;
     QProcess* process = nullptr;
 
 public:
+    static const unsigned int CHIP_SIZE = 0x80000;     // SST39SF040
+    static const unsigned int SECTOR_SIZE = 0x1000;
+
     explicit ThreadTL866(QObject *parent = nullptr);
 
     inline void set_operation(int _operation) {
@@ -32,8 +46,8 @@ public:
      * @brief Get output from process that has been transmitted from application
      * @return
      */
-    inline const auto& get_output() const {
-        return this->output;
+    inline QByteArray get_output() const {
+        return this->output_parser.get_log();
     }
 
     /**
@@ -52,6 +66,47 @@ public:
         this->data = _data;
     }
 
+    /**
+     * @brief Set the last known contents of the chip
+     *
+     * When writing changes only, this reference is compared against the data
+     * to decide which part of the chip has to be programmed.
+     */
+    inline void set_reference(const QByteArray& _reference) {
+        this->reference = _reference;
+    }
+
+    /**
+     * @brief Get the contents of the chip after a successful write
+     *
+     * When the chip is not erased, the part beyond the written prefix keeps
+     * the contents of the reference; otherwise it reads as 0xFF.
+     */
+    inline const auto& get_written_data() const {
+        return this->written_data;
+    }
+
+    /**
+     * @brief Set the manifest the chip is verified against
+     */
+    inline void set_manifest(const ImageManifest& _manifest) {
+        this->manifest = _manifest;
+    }
+
+    /**
+     * @brief Get the slots that deviate from the manifest after verification
+     */
+    inline const auto& get_mismatches() const {
+        return this->mismatches;
+    }
+
+    /**
+     * @brief Whether the operation completed without error
+     */
+    inline bool is_success() const {
+        return this->success;
+    }
+
     void run();
 
 private:
@@ -59,11 +114,15 @@ private:
 
     QProcess* build_process();
 
+    void plan_write();
+
 signals:
     void signal_read_done(void*);
 
     void signal_write_done(void*);
 
+    void signal_verify_done(void*);
+
     void signal_progress(int progress);
 
 private slots:
@@ -0,0 +1,113 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "tl866_output_parser.h"
+
+/**
+ * @brief Default constructor
+ */
+TL866OutputParser::TL866OutputParser() {}
+
+/**
+ * @brief Process a chunk of output
+ * @param chunk newly received bytes
+ * @return whether the progress percentage changed
+ */
+bool TL866OutputParser::feed(const QByteArray& chunk) {
+    bool changed = false;
+
+    for(const char c : chunk) {
+        // skip ANSI escape sequences such as ESC [ K
+        if(this->escape_state == 1) {
+            this->escape_state = (c == '[') ? 2 : 0;
+            continue;
+        }
+        if(this->escape_state == 2) {
+            if(c >= 0x40 && c <= 0x7E) { // final byte of control sequence
+                this->escape_state = 0;
+            }
+            continue;
+        }
+
+        switch(c) {
+            case 0x1B:
+                this->escape_state = 1;
+                this->digits.clear();
+            break;
+            case '\r':
+                this->carriage_return = true;
+                this->digits.clear();
+            break;
+            case '\n':
+                this->log.append(this->line);
+                this->log.append('\n');
+                this->line.clear();
+                this->carriage_return = false;
+                this->digits.clear();
+            break;
+            default:
+                changed |= this->put(c);
+            break;
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Get cleaned log, including the line currently being drawn
+ * @return log
+ */
+QByteArray TL866OutputParser::get_log() const {
+    return this->log + this->line;
+}
+
+/**
+ * @brief Process a single printable character
+ * @param c character
+ * @return whether the progress percentage changed
+ */
+bool TL866OutputParser::put(char c) {
+    // a carriage return followed by new content redraws the line
+    if(this->carriage_return) {
+        this->line.clear();
+        this->carriage_return = false;
+    }
+    this->line.append(c);
+
+    if(c >= '0' && c <= '9') {
+        if(this->digits.size() < 10) {
+            this->digits.append(c);
+        }
+        return false;
+    }
+
+    bool changed = false;
+    if(c == '%' && !this->digits.isEmpty()) {
+        const int perc = this->digits.toInt();
+        if(perc != this->progress) {
+            this->progress = perc;
+            changed = true;
+        }
+    }
+    this->digits.clear();
+
+    return changed;
+}
@@ -0,0 +1,81 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef TL866_OUTPUT_PARSER_H
+#define TL866_OUTPUT_PARSER_H
+
+#include <QByteArray>
+
+/**
+ * @brief Streaming parser for the console output of minipro
+ *
+ * Minipro redraws its progress line in place using carriage returns and the
+ * ANSI erase-line sequence (ESC [ K). The parser consumes the output chunk by
+ * chunk, only looking at newly arrived bytes, and keeps just enough state to
+ * handle percentages and escape sequences that are split across chunks. The
+ * log it builds contains the final state of every line, without redraws.
+ */
+class TL866OutputParser {
+private:
+    QByteArray log;             // completed lines
+    QByteArray line;            // line currently being drawn
+    QByteArray digits;          // digits of a percentage that may continue in the next chunk
+
+    bool carriage_return = false;   // line is overwritten by the next printable character
+    int escape_state = 0;           // 0 none, 1 after ESC, 2 inside control sequence
+    int progress = -1;              // last percentage seen
+
+public:
+    /**
+     * @brief Default constructor
+     */
+    TL866OutputParser();
+
+    /**
+     * @brief Process a chunk of output
+     * @param chunk newly received bytes
+     * @return whether the progress percentage changed
+     */
+    bool feed(const QByteArray& chunk);
+
+    /**
+     * @brief Get last percentage seen, -1 when none has been seen yet
+     * @return progress
+     */
+    inline int get_progress() const {
+        return this->progress;
+    }
+
+    /**
+     * @brief Get cleaned log, including the line currently being drawn
+     * @return log
+     */
+    QByteArray get_log() const;
+
+private:
+    /**
+     * @brief Process a single printable character
+     * @param c character
+     * @return whether the progress percentage changed
+     */
+    bool put(char c);
+};
+
+#endif // TL866_OUTPUT_PARSER_H
@@ -7,6 +7,8 @@ TL866Widget::TL866Widget(QWidget *parent) : QWidget(parent) {
     // establish connections
     connect(this->button_read_chip, SIGNAL(released()), this, SLOT(slot_read_chip()));
     connect(this->button_write_chip, SIGNAL(released()), this, SLOT(slot_write_chip()));
+    connect(this->button_write_changes, SIGNAL(released()), this, SLOT(slot_write_changes()));
+    connect(this->button_verify_chip, SIGNAL(released()), this, SLOT(slot_verify_chip()));
 }
 
 void TL866Widget::build_interface() {
@@ -24,14 +26,35 @@ void TL866Widget::build_interface() {
     this->button_write_chip = new QPushButton("Write chip");
     button_layout->addWidget(this->button_write_chip);
 
+    this->button_write_changes = new QPushButton("Write changes");
+    this->button_write_changes->setToolTip("Only program the sectors that differ from the last read or written image");
+    this->button_write_changes->setEnabled(false); // requires known chip contents
+    button_layout->addWidget(this->button_write_changes);
+
+    this->button_verify_chip = new QPushButton("Verify chip");
+    this->button_verify_chip->setToolTip("Compare the slot and sector hashes of the chip with the manifest of the image");
+    button_layout->addWidget(this->button_verify_chip);
+
     this->progress_bar = new QProgressBar();
     top_layout->addWidget(this->progress_bar);
+
+    this->label_verify = new QLabel();
+    this->label_verify->setWordWrap(true);
+    top_layout->addWidget(this->label_verify);
+}
+
+void TL866Widget::set_manifest_file(const QString& filename) {
+    this->manifest = ImageManifest();
+    if(this->manifest.load(filename)) {
+        this->label_verify->setText(tr("Verifying against %1 (%2 slots).").arg(QFileInfo(filename).fileName()).arg(this->manifest.get_nr_slots()));
+    } else {
+        this->label_verify->setText(tr("Could not load manifest %1.").arg(filename));
+    }
 }
 
 void TL866Widget::slot_read_chip() {
     qDebug() << "Launching chip read process.";
-    this->button_read_chip->setEnabled(false);
-    this->button_write_chip->setEnabled(false);
+    this->set_buttons_enabled(false);
     this->programmer_thread = std::make_unique<ThreadTL866>();
     this->programmer_thread->set_operation(0); // read operation
     this->progress_bar->setMinimum(0);
@@ -43,24 +66,87 @@ void TL866Widget::slot_read_chip() {
 
 void TL866Widget::slot_write_chip() {
     qDebug() << "Launching chip write process.";
+    this->start_write(1); // write operation
+}
+
+void TL866Widget::slot_write_changes() {
+    qDebug() << "Launching chip write process for changed sectors.";
+    this->start_write(2); // write changes operation
+}
+
+void TL866Widget::start_write(int operation) {
     emit(signal_get_data());
-    this->button_read_chip->setEnabled(false);
-    this->button_write_chip->setEnabled(false);
+    this->set_buttons_enabled(false);
     this->progress_bar->setMinimum(0);
     this->progress_bar->setMaximum(100);
     this->programmer_thread = std::make_unique<ThreadTL866>();
-    this->programmer_thread->set_operation(1); // write operation
+    this->programmer_thread->set_operation(operation);
     this->programmer_thread->set_data(this->flash_data);
+    this->programmer_thread->set_reference(this->chip_data);
     connect(this->programmer_thread.get(), SIGNAL(signal_write_done(void*)), this, SLOT(slot_write_done(void*)));
     connect(this->programmer_thread.get(), SIGNAL(signal_progress(int)), this->progress_bar, SLOT(setValue(int)));
     this->programmer_thread->start();
 }
 
+void TL866Widget::slot_verify_chip() {
+    // ask for a manifest when none has been set by loading or saving an image
+    if(this->manifest.is_empty()) {
+        QString filename = QFileDialog::getOpenFileName(this, tr("Open manifest"), "", tr("Image manifest (*.json)"));
+        if(filename.isEmpty()) {
+            return;
+        }
+        this->set_manifest_file(filename);
+        if(this->manifest.is_empty()) {
+            return;
+        }
+    }
+
+    qDebug() << "Launching chip verify process.";
+    this->set_buttons_enabled(false);
+    this->label_verify->setText(tr("Verifying..."));
+    this->programmer_thread = std::make_unique<ThreadTL866>();
+    this->programmer_thread->set_operation(3); // verify operation
+    this->programmer_thread->set_manifest(this->manifest);
+    this->progress_bar->setMinimum(0);
+    this->progress_bar->setMaximum(100);
+    connect(this->programmer_thread.get(), SIGNAL(signal_verify_done(void*)), this, SLOT(slot_verify_done(void*)));
+    connect(this->programmer_thread.get(), SIGNAL(signal_progress(int)), this->progress_bar, SLOT(setValue(int)));
+    this->programmer_thread->start();
+}
+
+void TL866Widget::set_buttons_enabled(bool enabled) {
+    this->button_read_chip->setEnabled(enabled);
+    this->button_write_chip->setEnabled(enabled);
+    this->button_write_changes->setEnabled(enabled && !this->chip_data.isEmpty());
+    this->button_verify_chip->setEnabled(enabled);
+}
+
+QString TL866Widget::build_verify_report(const std::vector<ImageManifest::Mismatch>& mismatches) const {
+    if(mismatches.empty()) {
+        return tr("PASS: all %1 slots match %2.").arg(this->manifest.get_nr_slots()).arg(this->manifest.get_image());
+    }
+
+    QStringList slot_list;
+    for(const auto& mismatch : mismatches) {
+        QStringList sector_list;
+        for(unsigned int sector : mismatch.sectors) {
+            sector_list.append(QString::number(sector));
+        }
+        slot_list.append(sector_list.isEmpty() ? tr("slot %1").arg(mismatch.slot) :
+                                                 tr("slot %1 (sectors %2)").arg(mismatch.slot).arg(sector_list.join(", ")));
+    }
+
+    return tr("FAIL: %1 of %2 slots deviate from %3: %4.").arg(mismatches.size()).arg(this->manifest.get_nr_slots())
+                                                         .arg(this->manifest.get_image()).arg(slot_list.join(", "));
+}
+
 void TL866Widget::slot_read_done(void*) {
-    this->button_read_chip->setEnabled(true);
-    this->button_write_chip->setEnabled(true);
     this->progress_bar->setValue(this->progress_bar->maximum());
     this->read_data = this->programmer_thread->get_data();
+    if(this->programmer_thread->is_success()) {
+        this->chip_data = this->read_data;
+    }
+    this->set_buttons_enabled(true);
     this->log_data = this->programmer_thread->get_output();
     emit(signal_data_read());
     emit(signal_log_read());
@@ -69,10 +155,38 @@ void TL866Widget::slot_read_done(void*) {
 
 void TL866Widget::slot_write_done(void*) {
     qDebug() << "Done writing to chip.";
-    this->button_read_chip->setEnabled(true);
-    this->button_write_chip->setEnabled(true);
     this->progress_bar->setValue(this->progress_bar->maximum());
+    if(this->programmer_thread->is_success()) {
+        this->chip_data = this->programmer_thread->get_written_data();
+
+        // verify against what has been written rather than the image last loaded or saved;
+        // the slots covered by the image are taken from the chip contents, as a write
+        // without a chip erase leaves the previous contents past the image in place
+        const unsigned int nr_slots = (this->flash_data.size() + ChipDescriptor::SLOT_SIZE - 1) / ChipDescriptor::SLOT_SIZE;
+        this->manifest = ImageManifest::from_image(this->chip_data.left(nr_slots * ChipDescriptor::SLOT_SIZE), tr("the written image"));
+        this->label_verify->setText(tr("Verifying against %1 (%2 slots).").arg(this->manifest.get_image()).arg(this->manifest.get_nr_slots()));
+    } else {
+        this->chip_data.clear(); // chip contents unknown after a failed write
+    }
+    this->set_buttons_enabled(true);
+    this->log_data = this->programmer_thread->get_output();
+    emit(signal_log_read());
+    this->programmer_thread.reset(); // clean object
+}
+
+void TL866Widget::slot_verify_done(void*) {
+    this->progress_bar->setValue(this->progress_bar->maximum());
+    QString report;
+    if(this->programmer_thread->is_success()) {
+        this->chip_data = this->programmer_thread->get_data();
+        report = this->build_verify_report(this->programmer_thread->get_mismatches());
+    } else {
+        report = tr("FAIL: the chip could not be read, see output log.");
+    }
+    this->label_verify->setText(report);
+    this->set_buttons_enabled(true);
     this->log_data = this->programmer_thread->get_output();
+    this->log_data.append(QString("\n%1\n").arg(report).toUtf8());
     emit(signal_log_read());
     this->programmer_thread.reset(); // clean object
 }
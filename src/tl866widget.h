@@ -7,6 +7,8 @@
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QProgressBar>
+#include <QLabel>
+#include <QFileDialog>
 
 #include "threadtl866.h"
 
@@ -16,11 +18,16 @@ class TL866Widget : public QWidget
 private:
     QPushButton* button_read_chip;
     QPushButton* button_write_chip;
+    QPushButton* button_write_changes;
+    QPushButton* button_verify_chip;
     QProgressBar* progress_bar;
+    QLabel* label_verify;
 
     std::unique_ptr<ThreadTL866> programmer_thread;
     QByteArray flash_data;
     QByteArray read_data;
+    QByteArray chip_data;   // last known contents of the chip
+    ImageManifest manifest; // expected contents of the chip for verification
     QByteArray log_data;
 
 public:
@@ -38,9 +45,17 @@ public:
         return this->log_data;
     }
 
+    void set_manifest_file(const QString& filename);
+
 private:
     void build_interface();
 
+    void start_write(int operation);
+
+    void set_buttons_enabled(bool enabled);
+
+    QString build_verify_report(const std::vector<ImageManifest::Mismatch>& mismatches) const;
+
 signals:
     /**
      * @brief Request to read data from this object
@@ -62,9 +77,15 @@ private slots:
 
     void slot_write_chip();
 
+    void slot_write_changes();
+
+    void slot_verify_chip();
+
     void slot_read_done(void*);
 
     void slot_write_done(void*);
+
+    void slot_verify_done(void*);
 };
 
 #endif // TL866WIDGET_H
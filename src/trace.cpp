@@ -0,0 +1,50 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#include "trace.h"
+
+Q_LOGGING_CATEGORY(trace_serial, "gbcr.serial", QtInfoMsg)
+Q_LOGGING_CATEGORY(trace_engine, "gbcr.engine", QtInfoMsg)
+Q_LOGGING_CATEGORY(trace_flash, "gbcr.flash", QtInfoMsg)
+
+#ifndef GBCR_NO_TRACE
+TraceBuffer::Record TraceBuffer::records[TraceBuffer::CAPACITY];
+std::atomic<quint64> TraceBuffer::nr_records{0};
+const std::chrono::steady_clock::time_point TraceBuffer::start = std::chrono::steady_clock::now();
+
+/**
+ * @brief Write the stored events to the log, oldest first
+ */
+void TraceBuffer::dump() {
+    static const char* names[] = {"sent", "echo", "payload", "response", "received", "failed"};
+
+    const quint64 end = nr_records.load();
+    const quint64 begin = end > CAPACITY ? end - CAPACITY : 0;
+    qCWarning(trace_engine) << "Last" << end - begin << "protocol events:";
+    for(quint64 i=begin; i<end; i++) {
+        const Record& r = records[i % CAPACITY];
+        qCWarning(trace_engine).noquote() << QString("%1 us %2 %3 %4")
+                                             .arg(r.time / 1000, 10)
+                                             .arg(QString(names[(int)r.event]), -8)
+                                             .arg(QString::fromLatin1(r.command, sizeof(r.command)))
+                                             .arg(r.value);
+    }
+}
+#endif
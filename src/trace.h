@@ -0,0 +1,127 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QLoggingCategory>
+#include <QDebug>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+/*
+ * Tracing of the communication with the cartridge reader
+ *
+ * Messages are logged per category. Debug messages are disabled by default
+ * and can be enabled at run time, e.g. QT_LOGGING_RULES="gbcr.*.debug=true".
+ * The arguments of a disabled message are not evaluated, such that the cost
+ * of a disabled message is a single branch. Building with
+ * DEFINES += GBCR_NO_TRACE removes all debug messages and the trace buffer
+ * from the binary.
+ *
+ * Independent of the logging, the events of the serial protocol are stored
+ * in binary form in a circular trace buffer, which is dumped to the log when
+ * a command fails.
+ */
+Q_DECLARE_LOGGING_CATEGORY(trace_serial)    // SerialInterface
+Q_DECLARE_LOGGING_CATEGORY(trace_engine)    // SerialCommandEngine
+Q_DECLARE_LOGGING_CATEGORY(trace_flash)     // FlashThread and its helpers
+
+#ifdef GBCR_NO_TRACE
+#define TRACE_DEBUG(category) while(false) QMessageLogger().noDebug()
+#define TRACE_EVENT(event, command, value) do {} while(false)
+#define TRACE_DUMP() do {} while(false)
+#else
+#define TRACE_DEBUG(category) qCDebug(category)
+#define TRACE_EVENT(event, command, value) TraceBuffer::record(event, command, value)
+#define TRACE_DUMP() TraceBuffer::dump()
+#endif
+
+#define TRACE_INFO(category) qCInfo(category)
+#define TRACE_WARNING(category) qCWarning(category)
+#define TRACE_CRITICAL(category) qCCritical(category)
+
+/**
+ * @brief Events of the serial protocol that are stored in the trace buffer
+ */
+enum class TraceEvent : quint8 {
+    COMMAND_SENT,       // command written, value: number of commands in flight
+    ECHO_RECEIVED,      // echo validated, value: 0
+    PAYLOAD_SENT,       // payload written, value: number of bytes
+    RESPONSE_RECEIVED,  // response complete, value: number of bytes
+    BYTES_RECEIVED,     // data read from the device, value: number of bytes
+    COMMAND_FAILED,     // command failed, value: number of unconsumed bytes
+};
+
+#ifndef GBCR_NO_TRACE
+/**
+ * @brief Circular buffer holding the most recent protocol events
+ *
+ * Recording an event takes a timestamp and a few stores, without any
+ * formatting or allocation. Events can be recorded from multiple threads;
+ * when events are recorded while the buffer is dumped, the dump may hold
+ * a partially overwritten record.
+ */
+class TraceBuffer {
+
+public:
+    struct Record {
+        qint64 time;            // ns since the first event
+        TraceEvent event;       // type of event
+        char command[8];        // command string involved in the event
+        quint32 value;          // event specific value
+    };
+
+    static const unsigned int CAPACITY = 1024;  // number of events that are kept
+
+private:
+    static Record records[CAPACITY];
+    static std::atomic<quint64> nr_records;
+    static const std::chrono::steady_clock::time_point start;
+
+public:
+    /**
+     * @brief Store an event
+     * @param event type of event
+     * @param command 8-byte command string, nullptr when not applicable
+     * @param value event specific value
+     */
+    static inline void record(TraceEvent event, const char* command, quint32 value) {
+        Record& r = records[nr_records.fetch_add(1, std::memory_order_relaxed) % CAPACITY];
+        r.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        r.event = event;
+        if(command != nullptr) {
+            memcpy(r.command, command, sizeof(r.command));
+        } else {
+            memset(r.command, ' ', sizeof(r.command));
+        }
+        r.value = value;
+    }
+
+    /**
+     * @brief Write the stored events to the log, oldest first
+     */
+    static void dump();
+};
+#endif
+
+#endif // TRACE_H
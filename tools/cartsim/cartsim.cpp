@@ -0,0 +1,544 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * Cartridge reader simulator
+ *
+ * Emulates the 32u4 cartridge reader board on a Linux pseudo-terminal such
+ * that the IDE (and SerialInterface in particular) can be exercised without
+ * hardware. The simulator speaks the same 8-byte command protocol as the
+ * board firmware and is backed by an in-memory model of a SST39SF0x0 chip.
+ *
+ * Usage: cartsim [options], see cartsim --help
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_signal(int) {
+    stop_requested = 1;
+}
+
+/**
+ * @brief Model of a SST39SF0x0 NOR flash chip
+ *
+ * Programming can only clear bits, erasing a sector sets all of its bytes
+ * to 0xFF. The JEDEC software command sequences for sector and chip erase
+ * are decoded from single-byte writes.
+ */
+class SST39SF0x0 {
+private:
+    std::vector<uint8_t> mem;
+    uint8_t device_id;
+    std::vector<std::pair<uint16_t, uint8_t>> sequence;    // recent single-byte writes
+
+public:
+    static const unsigned int SECTOR_SIZE = 0x1000;
+
+    SST39SF0x0(unsigned int capacity, uint8_t _device_id) :
+        mem(capacity, 0xFF),
+        device_id(_device_id) {}
+
+    inline unsigned int size() const {
+        return this->mem.size();
+    }
+
+    inline uint8_t get_device_id() const {
+        return this->device_id;
+    }
+
+    inline uint8_t read(unsigned int addr) const {
+        return this->mem[addr % this->mem.size()];
+    }
+
+    inline void program(unsigned int addr, uint8_t value) {
+        this->mem[addr % this->mem.size()] &= value;
+    }
+
+    void erase_sector(unsigned int addr) {
+        unsigned int start = (addr % this->mem.size()) & ~(SECTOR_SIZE - 1);
+        std::fill(this->mem.begin() + start, this->mem.begin() + start + SECTOR_SIZE, 0xFF);
+    }
+
+    void erase_chip() {
+        std::fill(this->mem.begin(), this->mem.end(), 0xFF);
+    }
+
+    /**
+     * @brief Single byte write on the bus (WR command)
+     * @return whether the write completed a chip erase sequence
+     */
+    bool bus_write(uint16_t addr, uint8_t value) {
+        static const std::pair<uint16_t, uint8_t> chip_erase[] = {
+            {0x5555, 0xAA}, {0x2AAA, 0x55}, {0x5555, 0x80},
+            {0x5555, 0xAA}, {0x2AAA, 0x55}, {0x5555, 0x10}
+        };
+
+        this->sequence.push_back(std::make_pair(addr, value));
+        if(this->sequence.size() > 6) {
+            this->sequence.erase(this->sequence.begin());
+        }
+
+        if(this->sequence.size() == 6 && std::equal(this->sequence.begin(), this->sequence.end(), chip_erase)) {
+            this->erase_chip();
+            this->sequence.clear();
+            return true;
+        }
+
+        return false;
+    }
+
+    bool load(const std::string& filename) {
+        std::ifstream in(filename, std::ios::binary);
+        if(!in) {
+            return false;
+        }
+        in.read((char*)this->mem.data(), this->mem.size());
+        return true;
+    }
+
+    bool save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        if(!out) {
+            return false;
+        }
+        out.write((const char*)this->mem.data(), this->mem.size());
+        return true;
+    }
+};
+
+/**
+ * @brief Simulation settings
+ */
+struct Settings {
+    std::string image;                  // initial chip contents
+    std::string save;                   // file to store chip contents upon exit
+    std::string link;                   // symlink pointing to the slave pty
+    std::string board_info = "Ph2k-32u4-v0.0.0";
+    unsigned int chip = 40;             // 10, 20 or 40 (SST39SF010/020/040)
+    unsigned int latency = 0;           // turnaround time per command (us)
+    unsigned int baud = 0;              // emulated line rate, 0 for unlimited
+    unsigned int erase_time = 0;        // time per sector erase (us)
+    unsigned int burn_time = 0;         // time per block burn (us)
+    double fault_rate = 0.0;            // probability of a fault per command
+    std::vector<std::string> faults;    // fault types to inject
+    unsigned int seed = 0;
+    bool legacy_eeprom = false;         // only support single-byte EEPROM reads (RBEP)
+    bool verbose = false;
+};
+
+/**
+ * @brief Protocol handler of the cartridge reader
+ */
+class CartridgeSimulator {
+private:
+    int fd;                             // master side of the pty
+    Settings settings;
+    SST39SF0x0 chip;
+    std::vector<uint8_t> eeprom;
+    std::mt19937 rng;
+    unsigned long nr_commands = 0;
+    unsigned long nr_faults = 0;
+
+public:
+    CartridgeSimulator(int _fd, const Settings& _settings) :
+        fd(_fd),
+        settings(_settings),
+        chip(capacity(_settings.chip), device_id(_settings.chip)),
+        eeprom(0x400, 0xFF),
+        rng(_settings.seed) {}
+
+    SST39SF0x0& get_chip() {
+        return this->chip;
+    }
+
+    void run() {
+        uint8_t command[8];
+        while(!stop_requested) {
+            if(!this->read_bytes(command, 8)) {
+                continue;
+            }
+            this->nr_commands++;
+            this->handle(std::string((char*)command, 8));
+        }
+
+        std::cerr << "Handled " << this->nr_commands << " commands, injected " << this->nr_faults << " faults." << std::endl;
+    }
+
+private:
+    static unsigned int capacity(unsigned int chip) {
+        switch(chip) {
+            case 10: return 0x20000;
+            case 20: return 0x40000;
+            case 40: return 0x80000;
+            default: throw std::runtime_error("Unsupported chip, use 10, 20 or 40.");
+        }
+    }
+
+    static uint8_t device_id(unsigned int chip) {
+        switch(chip) {
+            case 10: return 0xB5;
+            case 20: return 0xB6;
+            default: return 0xB7;
+        }
+    }
+
+    /**
+     * @brief Pick a fault to inject for the current command, if any
+     * @param candidates faults applicable to the current command
+     * @return fault type or empty string
+     */
+    std::string pick_fault(const std::vector<std::string>& candidates) {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        if(this->settings.fault_rate <= 0.0 || dist(this->rng) >= this->settings.fault_rate) {
+            return "";
+        }
+
+        std::vector<std::string> options;
+        for(const auto& f : this->settings.faults) {
+            if(std::find(candidates.begin(), candidates.end(), f) != candidates.end()) {
+                options.push_back(f);
+            }
+        }
+        if(options.empty()) {
+            return "";
+        }
+
+        this->nr_faults++;
+        std::string fault = options[this->rng() % options.size()];
+        std::cerr << "Injecting fault: " << fault << std::endl;
+        return fault;
+    }
+
+    void handle(const std::string& cmd) {
+        if(this->settings.verbose) {
+            std::cerr << "Command: " << cmd << std::endl;
+        }
+
+        if(this->settings.latency > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(this->settings.latency));
+        }
+
+        std::string fault = this->pick_fault({"drop", "echo", "stall", "bitflip", "checksum"});
+        if(fault == "drop") {
+            return;
+        }
+        if(fault == "stall") {
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+        }
+
+        // echo the command
+        std::string echo = cmd;
+        if(fault == "echo") {
+            echo[0] ^= 0x20;
+        }
+        this->write_bytes((const uint8_t*)echo.data(), 8);
+
+        std::string op4 = cmd.substr(0, 4);
+        if(cmd == "READINFO") {
+            std::string info = this->settings.board_info;
+            info.resize(16, ' ');
+            this->write_bytes((const uint8_t*)info.data(), 16);
+        } else if(cmd == "DEVIDSST") {
+            uint8_t response[2] = {0xBF, this->chip.get_device_id()};
+            this->write_bytes(response, 2);
+        } else if(op4 == "RDBK") {
+            unsigned int addr = parse_hex(cmd.substr(4, 4)) * 0x100;
+            uint8_t block[0x100];
+            for(unsigned int i=0; i<0x100; i++) {
+                block[i] = this->chip.read(addr + i);
+            }
+            if(fault == "bitflip") {
+                block[this->rng() % 0x100] ^= 1 << (this->rng() % 8);
+            }
+            this->write_bytes(block, 0x100);
+        } else if(op4 == "WRBK") {
+            unsigned int addr = parse_hex(cmd.substr(4, 4)) * 0x100;
+            uint8_t block[0x100];
+            if(!this->read_bytes(block, 0x100, true)) {
+                return;
+            }
+            uint8_t checksum = 0;
+            for(unsigned int i=0; i<0x100; i++) {
+                checksum += block[i];
+                if(fault != "checksum") {
+                    this->chip.program(addr + i, block[i]);
+                }
+            }
+            if(fault == "checksum") {
+                checksum ^= 0xFF;
+            }
+            if(this->settings.burn_time > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(this->settings.burn_time));
+            }
+            this->write_bytes(&checksum, 1);
+        } else if(op4 == "ESST") {
+            unsigned int addr = parse_hex(cmd.substr(4, 4)) * 0x100;
+            this->chip.erase_sector(addr);
+            if(this->settings.erase_time > 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(this->settings.erase_time));
+            }
+            uint8_t cycles[2] = {0x10, 0x00};
+            this->write_bytes(cycles, 2);
+        } else if(op4 == "RBEP") {
+            unsigned int addr = parse_hex(cmd.substr(4, 4));
+            uint8_t value = this->eeprom[addr % this->eeprom.size()];
+            this->write_bytes(&value, 1);
+        } else if(op4.substr(0, 3) == "REP" && !this->settings.legacy_eeprom) {
+            // ranged EEPROM read: REP<addr:3><count:2>, a count of 00 reads 0x100 bytes
+            unsigned int addr = parse_hex(cmd.substr(3, 3));
+            unsigned int count = parse_hex(cmd.substr(6, 2));
+            count = count == 0 ? 0x100 : count;
+            std::vector<uint8_t> data(count);
+            for(unsigned int i=0; i<count; i++) {
+                data[i] = this->eeprom[(addr + i) % this->eeprom.size()];
+            }
+            this->write_bytes(data.data(), count);
+        } else if(op4.substr(0, 3) == "WEP" && !this->settings.legacy_eeprom) {
+            // ranged EEPROM write: WEP<addr:3><count:2> followed by the data, answered by a checksum
+            unsigned int addr = parse_hex(cmd.substr(3, 3));
+            unsigned int count = parse_hex(cmd.substr(6, 2));
+            count = count == 0 ? 0x100 : count;
+            std::vector<uint8_t> data(count);
+            if(!this->read_bytes(data.data(), count, true)) {
+                return;
+            }
+            uint8_t checksum = 0;
+            for(unsigned int i=0; i<count; i++) {
+                this->eeprom[(addr + i) % this->eeprom.size()] = data[i];
+                checksum += data[i];
+            }
+            this->write_bytes(&checksum, 1);
+        } else if(cmd.substr(0, 2) == "WR") {
+            uint16_t addr = parse_hex(cmd.substr(2, 4));
+            uint8_t value = parse_hex(cmd.substr(6, 2));
+            if(this->chip.bus_write(addr, value)) {
+                std::cerr << "Chip erase" << std::endl;
+                if(this->settings.erase_time > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(this->settings.erase_time * 4));
+                }
+            }
+        } else {
+            std::cerr << "Unknown command: " << cmd << std::endl;
+        }
+    }
+
+    static unsigned int parse_hex(const std::string& str) {
+        return std::stoul(str, nullptr, 16);
+    }
+
+    /**
+     * @brief Read a number of bytes from the pty
+     * @param dest destination
+     * @param nrbytes number of bytes
+     * @param wait whether to keep waiting for the bytes until terminated
+     * @return whether all bytes were read
+     */
+    bool read_bytes(uint8_t* dest, size_t nrbytes, bool wait = true) {
+        size_t nr_read = 0;
+        while(nr_read < nrbytes && !stop_requested) {
+            struct pollfd pfd = {this->fd, POLLIN, 0};
+            int res = poll(&pfd, 1, 200);
+            if(res <= 0) {
+                if(!wait) {
+                    return false;
+                }
+                continue;
+            }
+
+            ssize_t n = ::read(this->fd, dest + nr_read, nrbytes - nr_read);
+            if(n > 0) {
+                nr_read += n;
+            } else {
+                // no client connected to the slave side; avoid spinning
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        }
+
+        return nr_read == nrbytes;
+    }
+
+    /**
+     * @brief Write bytes to the pty, emulating the line rate
+     */
+    void write_bytes(const uint8_t* src, size_t nrbytes) {
+        if(this->settings.baud > 0) {
+            // 10 bits per byte (start, 8 data, stop)
+            std::this_thread::sleep_for(std::chrono::microseconds(nrbytes * 10 * 1000000ULL / this->settings.baud));
+        }
+
+        size_t nr_written = 0;
+        while(nr_written < nrbytes) {
+            ssize_t n = ::write(this->fd, src + nr_written, nrbytes - nr_written);
+            if(n > 0) {
+                nr_written += n;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+};
+
+static void print_help() {
+    std::cout << "Usage: cartsim [options]\n"
+                 "  --chip <10|20|40>       emulated SST39SF0x0 chip (default 40)\n"
+                 "  --image <file>          initial chip contents\n"
+                 "  --save <file>           store chip contents upon exit\n"
+                 "  --link <path>           create a symlink to the pty at path\n"
+                 "  --board-info <string>   response to READINFO (16 characters)\n"
+                 "  --latency <us>          turnaround time per command\n"
+                 "  --baud <rate>           emulate the line rate of responses\n"
+                 "  --erase-time <us>       duration of a sector erase\n"
+                 "  --burn-time <us>        duration of a block burn\n"
+                 "  --fault-rate <p>        probability of injecting a fault per command\n"
+                 "  --faults <list>         comma-separated list of drop,echo,stall,bitflip,checksum\n"
+                 "  --seed <n>              seed of the fault injection\n"
+                 "  --legacy-eeprom         emulate firmware without ranged EEPROM commands (REP/WEP)\n"
+                 "  --verbose               print every command\n";
+}
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    settings.faults = {"drop", "echo", "bitflip", "checksum"};
+
+    for(int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if(i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if(arg == "--help" || arg == "-h") {
+            print_help();
+            return 0;
+        } else if(arg == "--chip") {
+            settings.chip = std::stoul(next());
+        } else if(arg == "--image") {
+            settings.image = next();
+        } else if(arg == "--save") {
+            settings.save = next();
+        } else if(arg == "--link") {
+            settings.link = next();
+        } else if(arg == "--board-info") {
+            settings.board_info = next();
+        } else if(arg == "--latency") {
+            settings.latency = std::stoul(next());
+        } else if(arg == "--baud") {
+            settings.baud = std::stoul(next());
+        } else if(arg == "--erase-time") {
+            settings.erase_time = std::stoul(next());
+        } else if(arg == "--burn-time") {
+            settings.burn_time = std::stoul(next());
+        } else if(arg == "--fault-rate") {
+            settings.fault_rate = std::stod(next());
+        } else if(arg == "--faults") {
+            settings.faults.clear();
+            std::string list = next();
+            size_t pos = 0;
+            while(pos <= list.size()) {
+                size_t end = list.find(',', pos);
+                if(end == std::string::npos) {
+                    end = list.size();
+                }
+                settings.faults.push_back(list.substr(pos, end - pos));
+                pos = end + 1;
+            }
+        } else if(arg == "--seed") {
+            settings.seed = std::stoul(next());
+        } else if(arg == "--legacy-eeprom") {
+            settings.legacy_eeprom = true;
+        } else if(arg == "--verbose") {
+            settings.verbose = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_help();
+            return 1;
+        }
+    }
+
+    // create the pseudo-terminal
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("Could not create pseudo-terminal");
+        return 1;
+    }
+    std::string slave_name = ptsname(master);
+
+    // put the line in raw mode; keep the slave open such that the master
+    // does not signal a hangup when the IDE closes the port
+    int slave = open(slave_name.c_str(), O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    if(!settings.link.empty()) {
+        unlink(settings.link.c_str());
+        if(symlink(slave_name.c_str(), settings.link.c_str()) != 0) {
+            perror("Could not create symlink");
+        }
+    }
+
+    std::cout << slave_name << std::endl;
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    CartridgeSimulator simulator(master, settings);
+    if(!settings.image.empty() && !simulator.get_chip().load(settings.image)) {
+        std::cerr << "Could not load " << settings.image << std::endl;
+        return 1;
+    }
+
+    simulator.run();
+
+    if(!settings.save.empty() && !simulator.get_chip().save(settings.save)) {
+        std::cerr << "Could not save " << settings.save << std::endl;
+    }
+    if(!settings.link.empty()) {
+        unlink(settings.link.c_str());
+    }
+
+    close(slave);
+    close(master);
+
+    return 0;
+}
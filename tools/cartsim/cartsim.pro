@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = cartsim
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    cartsim.cpp
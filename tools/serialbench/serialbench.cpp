@@ -0,0 +1,240 @@
+/****************************************************************************
+ *                                                                          *
+ *   GBCR                                                                   *
+ *   Copyright (C) 2021 Ivo Filot <ivo@ivofilot.nl>                         *
+ *                                                                          *
+ *   This program is free software: you can redistribute it and/or modify   *
+ *   it under the terms of the GNU Lesser General Public License as         *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   This program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU General Public License for more details.                           *
+ *                                                                          *
+ *   You should have received a copy of the GNU General Public license      *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>. *
+ *                                                                          *
+ ****************************************************************************/
+
+/*
+ * Serial throughput and latency benchmark
+ *
+ * Drives SerialInterface against a cartridge reader (or the cartsim
+ * simulator) and reports per-command latency percentiles, the effective
+ * throughput of full-slot operations and the split between waiting for the
+ * command echo and transferring the payload.
+ *
+ * WARNING: unless --read-only is given, the selected slot is erased and
+ *          overwritten with random data.
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+
+#include "serial_interface.h"
+
+/**
+ * @brief Collects command timings per command type
+ */
+class TimingCollector {
+private:
+    struct Samples {
+        std::vector<double> latency;        // issue to completion (us)
+        double echo_time = 0.0;             // issue to echo (us)
+        double payload_time = 0.0;          // echo to completion (us)
+        size_t nrbytes = 0;
+    };
+
+    std::map<std::string, Samples> samples;
+
+public:
+    void record(const SerialCommandTiming& timing) {
+        auto& s = this->samples[timing.command.left(4).toStdString()];
+        s.latency.push_back((timing.completed - timing.issued) / 1000.0);
+        s.echo_time += (timing.echoed - timing.issued) / 1000.0;
+        s.payload_time += (timing.completed - timing.echoed) / 1000.0;
+        s.nrbytes += timing.nrbytes;
+    }
+
+    void clear() {
+        this->samples.clear();
+    }
+
+    void report() {
+        printf("%-6s %8s %10s %10s %10s %10s %10s %8s\n", "cmd", "count", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)", "echo (%)", "payload");
+        for(auto& item : this->samples) {
+            auto& lat = item.second.latency;
+            std::sort(lat.begin(), lat.end());
+            double total = item.second.echo_time + item.second.payload_time;
+            printf("%-6s %8zu %10.0f %10.0f %10.0f %10.0f %10.1f %7.1f%%\n",
+                   item.first.c_str(), lat.size(),
+                   percentile(lat, 0.50), percentile(lat, 0.90), percentile(lat, 0.99), lat.back(),
+                   total > 0 ? 100.0 * item.second.echo_time / total : 0.0,
+                   total > 0 ? 100.0 * item.second.payload_time / total : 0.0);
+        }
+    }
+
+private:
+    static double percentile(const std::vector<double>& sorted, double p) {
+        if(sorted.empty()) {
+            return 0.0;
+        }
+        size_t idx = std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+        return sorted[idx];
+    }
+};
+
+/**
+ * @brief Print throughput of a timed operation
+ */
+static void report_throughput(const char* name, size_t nrbytes, qint64 nsecs) {
+    double seconds = nsecs / 1e9;
+    printf("%-28s %8zu bytes in %8.3f s : %10.0f bytes/s\n", name, nrbytes, seconds, nrbytes / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("serialbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serial throughput and latency benchmark for the P2000T cartridge reader.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption({"p", "port"}, "Serial port of the cartridge reader.", "port"));
+    parser.addOption(QCommandLineOption({"b", "baud"}, "Baud rate (default 115200).", "baud", "115200"));
+    parser.addOption(QCommandLineOption({"s", "slot"}, "Slot used for the benchmark (default 31).", "slot", "31"));
+    parser.addOption(QCommandLineOption({"n", "iterations"}, "Iterations of the latency tests (default 64).", "n", "64"));
+    parser.addOption(QCommandLineOption({"w", "window"}, "Number of read requests kept in flight (default 4).", "window", "4"));
+    parser.addOption(QCommandLineOption({"r", "read-only"}, "Skip the tests that erase and write the slot."));
+    parser.addOption(QCommandLineOption({"c", "capture"}, "Record the serial traffic to a binary log.", "file"));
+    parser.addOption(QCommandLineOption("replay", "Replay a recorded session instead of using a port.", "file"));
+    parser.addOption(QCommandLineOption("fast", "Replay without the timing of the recorded session."));
+    parser.process(app);
+
+    if(!parser.isSet("port") && !parser.isSet("replay")) {
+        parser.showHelp(1);
+    }
+
+    const unsigned int slot = parser.value("slot").toUInt();
+    const unsigned int iterations = parser.value("iterations").toUInt();
+    const unsigned int first_block = ChipDescriptor::get_slot_block(slot);
+    const bool read_only = parser.isSet("read-only");
+
+    TimingCollector collector;
+    SerialInterface serial(parser.value("port").toStdString(), parser.value("baud").toInt());
+    serial.set_read_window(parser.value("window").toUInt());
+    if(parser.isSet("replay")) {
+        serial.set_replay_file(parser.value("replay").toStdString(), !parser.isSet("fast"));
+    } else if(parser.isSet("capture")) {
+        serial.set_capture_file(parser.value("capture").toStdString());
+    }
+    serial.set_timing_sink([&collector](const SerialCommandTiming& timing) {
+        collector.record(timing);
+    });
+
+    try {
+        serial.open_port();
+        printf("Board: %s\n", serial.get_board_info().c_str());
+        printf("Chip id: %04X\n", serial.get_chip_id());
+        printf("Slot: %u%s\n\n", slot, read_only ? " (read-only)" : "");
+
+        // per-command latency, one command at a time
+        collector.clear();
+        for(unsigned int i=0; i<iterations; i++) {
+            serial.read_block(first_block + (i % 64));
+        }
+
+        std::mt19937 rng(0);
+        QByteArray image(64 * 0x100, 0);
+        for(int i=0; i<image.size(); i++) {
+            image[i] = (char)(rng() & 0xFF);
+        }
+
+        if(!read_only) {
+            for(unsigned int i=0; i<iterations; i++) {
+                if(i % 16 == 0) {
+                    serial.erase_sector(first_block + (i % 64));
+                }
+                serial.burn_block(first_block + (i % 64), image.mid((i % 64) * 0x100, 0x100));
+            }
+        }
+
+        printf("Per-command latency\n");
+        collector.report();
+        printf("\n");
+
+        // full-slot throughput
+        QElapsedTimer timer;
+        timer.start();
+        QByteArray slot_data = serial.read_blocks(first_block, 64);
+        report_throughput("Read slot (pipelined)", slot_data.size(), timer.nsecsElapsed());
+
+        if(!read_only) {
+            timer.restart();
+            for(unsigned int i=0; i<64; i++) {
+                if(i % 16 == 0) {
+                    serial.erase_sector(first_block + i);
+                }
+                serial.burn_block(first_block + i, image.mid(i * 0x100, 0x100));
+            }
+            report_throughput("Flash slot", image.size(), timer.nsecsElapsed());
+
+            timer.restart();
+            QByteArray verify_data = serial.read_blocks(first_block, 64);
+            report_throughput("Verify slot (read-back)", verify_data.size(), timer.nsecsElapsed());
+            if(verify_data != image) {
+                printf("WARNING: read-back data does not match written data\n");
+            }
+
+            timer.restart();
+            unsigned int nr_mismatch = 0;
+            for(unsigned int i=0; i<64; i++) {
+                if(i % 16 == 0) {
+                    serial.erase_sector(first_block + i);
+                }
+                QByteArray block = image.mid(i * 0x100, 0x100);
+                if(serial.burn_block_verify(first_block + i, block) != qChecksum(block.constData(), block.size())) {
+                    nr_mismatch++;
+                }
+            }
+            report_throughput("Flash slot (integrated verify)", image.size(), timer.nsecsElapsed());
+            if(nr_mismatch > 0) {
+                printf("WARNING: %u blocks failed verification\n", nr_mismatch);
+            }
+
+            timer.restart();
+            nr_mismatch = 0;
+            for(unsigned int i=0; i<64; i++) {
+                if(i % 16 == 0) {
+                    serial.queue_erase_sector(first_block + i);
+                }
+                QByteArray block = image.mid(i * 0x100, 0x100);
+                uint16_t crc = qChecksum(block.constData(), block.size());
+                serial.queue_burn_block_verify(first_block + i, block, [&nr_mismatch, crc](bool acknowledged, uint16_t crc_chip) {
+                    if(!acknowledged || crc_chip != crc) {
+                        nr_mismatch++;
+                    }
+                });
+            }
+            serial.wait_for_queue();
+            report_throughput("Flash slot (pipelined)", image.size(), timer.nsecsElapsed());
+            if(nr_mismatch > 0) {
+                printf("WARNING: %u blocks failed verification\n", nr_mismatch);
+            }
+        }
+
+        serial.close_port();
+    }  catch (std::exception& e) {
+        fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
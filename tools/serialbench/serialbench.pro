@@ -0,0 +1,32 @@
+QT = core serialport
+
+TEMPLATE = app
+TARGET = serialbench
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    serialbench.cpp \
+    ../../src/chipdescriptor.cpp \
+    ../../src/serial_capture.cpp \
+    ../../src/serial_command_engine.cpp \
+    ../../src/serial_interface.cpp \
+    ../../src/serial_ring_buffer.cpp \
+    ../../src/trace.cpp
+
+HEADERS += \
+    ../../src/cancellationtoken.h \
+    ../../src/chipdescriptor.h \
+    ../../src/serial_capture.h \
+    ../../src/serial_command_engine.h \
+    ../../src/serial_interface.h \
+    ../../src/serial_ring_buffer.h \
+    ../../src/trace.h
+
+# add libraries
+win32 {
+    INCLUDEPATH +=  "D:\PROGRAMMING\LIBS\boost-1.74.0-win-x64\include"
+}